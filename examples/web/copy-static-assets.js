@@ -6,6 +6,7 @@ import { fileURLToPath } from "node:url";
 // bundle, if using its default asset location settings.
 const files = [
   "tesseract-core.wasm", // Main OCR engine module
+  "tesseract-core-relaxed.wasm", // Faster version for browsers with relaxed SIMD support
   "tesseract-core-fallback.wasm", // Slower version for browsers without SIMD support
   "tesseract-worker.js", // JS entry point for the web worker
 ];
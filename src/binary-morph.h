@@ -0,0 +1,304 @@
+#ifndef OCRLIB_BINARY_MORPH_H
+#define OCRLIB_BINARY_MORPH_H
+
+#include <leptonica/allheaders.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
+
+/**
+ * Brick morphology for 1bpp images, using WASM SIMD when available.
+ *
+ * The `pix*Brick` functions here give the same results as the Leptonica
+ * functions of the same name, with Leptonica's default (asymmetric) boundary
+ * conditions, for bricks that are a single row or column of pixels. Other
+ * images and bricks are handed to Leptonica.
+ *
+ * Leptonica implements a brick of size N as N shifted copies of the image,
+ * combined word by word. Here each row is instead combined with copies of
+ * itself shifted by 1, 2, 4... pixels, so a brick of size N takes about
+ * log2(N) passes over the row, each of which processes four words at a time.
+ */
+namespace binary_morph {
+
+enum class Op { Dilate, Erode };
+
+// One step of a horizontal morphology operation.
+struct RowStep {
+  Op op;
+  int size;
+  // If true, pixels outside the image are reset before this step, to OFF for
+  // dilation or ON for erosion. If false, the output of the previous step
+  // outside the image is used, which gives a "safe" closing.
+  bool reset_outside;
+};
+
+// Set bits [start, end) of `buf` to `value`. Bits are numbered MSB first.
+inline void fill_bits(uint32_t* buf, size_t start, size_t end, bool value) {
+  while (start < end && start % 32 != 0) {
+    uint32_t bit = 0x80000000u >> (start % 32);
+    buf[start / 32] = value ? buf[start / 32] | bit : buf[start / 32] & ~bit;
+    start++;
+  }
+  std::fill(buf + start / 32, buf + end / 32, value ? ~0u : 0u);
+  for (start = std::max(start, end / 32 * 32); start < end; start++) {
+    uint32_t bit = 0x80000000u >> (start % 32);
+    buf[start / 32] = value ? buf[start / 32] | bit : buf[start / 32] & ~bit;
+  }
+}
+
+// Return the 32 bits of `buf` starting at bit `32 * i + shift`.
+inline uint32_t shifted_word(const uint32_t* buf, size_t i, size_t shift) {
+  size_t q = shift / 32;
+  int r = shift % 32;
+  if (r == 0) {
+    return buf[i + q];
+  }
+  return (buf[i + q] << r) | (buf[i + q + 1] >> (32 - r));
+}
+
+#ifdef __wasm_simd128__
+// SIMD version of `shifted_word` for words [i, i + 4).
+inline v128_t shifted_words4(const uint32_t* buf, size_t i, size_t shift) {
+  size_t q = shift / 32;
+  int r = shift % 32;
+  v128_t lo = wasm_v128_load(buf + i + q);
+  if (r == 0) {
+    return lo;
+  }
+  v128_t hi = wasm_v128_load(buf + i + q + 1);
+  return wasm_v128_or(wasm_i32x4_shl(lo, r), wasm_u32x4_shr(hi, 32 - r));
+}
+#endif
+
+// Combine each bit `p` of words [0, count) of `buf` with bit `p + shift`.
+//
+// `count` must be a multiple of 4 and `buf` must have `shift / 32 + 5` words
+// after the first `count`. This works in place because each word only depends
+// on words at the same or higher indices.
+inline void combine_shifted(uint32_t* buf, size_t count, size_t shift, Op op) {
+#ifdef __wasm_simd128__
+  for (size_t i = 0; i < count; i += 4) {
+    v128_t a = wasm_v128_load(buf + i);
+    v128_t b = shifted_words4(buf, i, shift);
+    wasm_v128_store(buf + i, op == Op::Dilate ? wasm_v128_or(a, b)
+                                              : wasm_v128_and(a, b));
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    uint32_t b = shifted_word(buf, i, shift);
+    buf[i] = op == Op::Dilate ? buf[i] | b : buf[i] & b;
+  }
+#endif
+}
+
+// Copy `count` words into `out`, starting at bit `shift` of `buf`.
+inline void copy_shifted(const uint32_t* buf, uint32_t* out, size_t count,
+                         size_t shift) {
+  size_t i = 0;
+#ifdef __wasm_simd128__
+  for (; i + 4 <= count; i += 4) {
+    wasm_v128_store(out + i, shifted_words4(buf, i, shift));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = shifted_word(buf, i, shift);
+  }
+}
+
+// Clear the bits of each row of `pix` that are past the right edge of the
+// image.
+inline void clear_row_padding(PIX* pix) {
+  int width = pixGetWidth(pix);
+  if (width % 32 == 0) {
+    return;
+  }
+  uint32_t mask = ~0u << (32 - width % 32);
+  l_uint32* line = pixGetData(pix) + width / 32;
+  int wpl = pixGetWpl(pix);
+  for (int y = 0; y < pixGetHeight(pix); y++, line += wpl) {
+    *line &= mask;
+  }
+}
+
+// Apply `steps` to each row of the 1bpp image `pixs` and write the results
+// to `pixd`, which has the same size and may be `pixs`.
+inline void morph_rows(PIX* pixd, PIX* pixs, const std::vector<RowStep>& steps) {
+  int width = pixGetWidth(pixs);
+  int height = pixGetHeight(pixs);
+  int wpls = pixGetWpl(pixs);
+  int wpld = pixGetWpl(pixd);
+
+  // Each row is copied into the middle of a buffer with room on either side
+  // for the pixels outside the image that the steps read and write.
+  int reach = 0;
+  for (const auto& step : steps) {
+    reach += step.size;
+  }
+  size_t pad = reach / 32 + 1;
+  size_t count = (pad + wpls + pad + 3) / 4 * 4;
+  size_t guard = pad + 8;
+  std::vector<uint32_t> buf(count + guard);
+  size_t buf_bits = buf.size() * 32;
+
+  const l_uint32* src = pixGetData(pixs);
+  l_uint32* dst = pixGetData(pixd);
+  for (int y = 0; y < height; y++, src += wpls, dst += wpld) {
+    bool outside = steps.front().op == Op::Erode;
+    std::fill(buf.begin(), buf.end(), outside ? ~0u : 0u);
+    std::copy(src, src + wpls, buf.begin() + pad);
+    size_t origin = pad * 32;
+    fill_bits(buf.data(), origin + width, buf_bits, outside);
+
+    for (size_t s = 0; s < steps.size(); s++) {
+      const auto& step = steps[s];
+      if (s > 0 && step.reset_outside) {
+        outside = step.op == Op::Erode;
+        fill_bits(buf.data(), 0, origin, outside);
+        fill_bits(buf.data(), origin + width, buf_bits, outside);
+      }
+
+      // Combine each pixel `p` with pixels `[p, p + size)`, by combining with
+      // copies shifted by doubling amounts.
+      int n = 1;
+      for (; n * 2 <= step.size; n *= 2) {
+        combine_shifted(buf.data(), count, n, step.op);
+      }
+      if (n < step.size) {
+        combine_shifted(buf.data(), count, step.size - n, step.op);
+      }
+
+      // Move the origin to account for where the brick's center is. Leptonica
+      // places it at `size / 2`, and dilation uses the reflected brick.
+      int center = step.size / 2;
+      origin -= step.op == Op::Dilate ? step.size - 1 - center : center;
+    }
+
+    copy_shifted(buf.data(), dst, wpld, origin);
+  }
+  clear_row_padding(pixd);
+}
+
+// Dilate or erode the 1bpp image `pixs` vertically by `size` rows and write
+// the result to `pixd`, which must be a different image of the same size.
+inline void morph_columns(PIX* pixd, PIX* pixs, Op op, int size) {
+  int height = pixGetHeight(pixs);
+  int wpl = pixGetWpl(pixs);
+  int center = size / 2;
+  int first = op == Op::Dilate ? center - size + 1 : -center;
+
+  const l_uint32* src = pixGetData(pixs);
+  l_uint32* dst = pixGetData(pixd);
+  for (int y = 0; y < height; y++) {
+    l_uint32* out = dst + y * wpl;
+
+    // Rows outside the image are OFF for dilation and ON for erosion, so they
+    // don't affect the result.
+    int start = std::max(0, y + first);
+    int end = std::min(height, y + first + size);
+    if (start >= end) {
+      std::fill(out, out + wpl, op == Op::Dilate ? 0u : ~0u);
+      continue;
+    }
+    std::copy(src + start * wpl, src + (start + 1) * wpl, out);
+    for (int row = start + 1; row < end; row++) {
+      const l_uint32* in = src + row * wpl;
+      int i = 0;
+#ifdef __wasm_simd128__
+      for (; i + 4 <= wpl; i += 4) {
+        v128_t a = wasm_v128_load(out + i);
+        v128_t b = wasm_v128_load(in + i);
+        wasm_v128_store(out + i, op == Op::Dilate ? wasm_v128_or(a, b)
+                                                  : wasm_v128_and(a, b));
+      }
+#endif
+      for (; i < wpl; i++) {
+        out[i] = op == Op::Dilate ? out[i] | in[i] : out[i] & in[i];
+      }
+    }
+  }
+  clear_row_padding(pixd);
+}
+
+// Return true if the functions in this file can handle the arguments
+// themselves.
+inline bool can_morph(PIX* pixd, PIX* pixs, int hsize, int vsize) {
+  if (pixGetDepth(pixs) != 1 || hsize < 1 || vsize < 1 ||
+      (hsize > 1 && vsize > 1)) {
+    return false;
+  }
+  return !pixd || (pixGetDepth(pixd) == 1 &&
+                   pixGetWidth(pixd) == pixGetWidth(pixs) &&
+                   pixGetHeight(pixd) == pixGetHeight(pixs));
+}
+
+// Run a vertical operation, which can't write to its input, into `pixd`.
+inline PIX* morph_columns_into(PIX* pixd, PIX* pixs, Op op, int size) {
+  if (pixd == pixs) {
+    PIX* pixt = pixCopy(nullptr, pixs);
+    morph_columns(pixd, pixt, op, size);
+    pixDestroy(&pixt);
+  } else {
+    morph_columns(pixd, pixs, op, size);
+  }
+  return pixd;
+}
+
+}  // namespace binary_morph
+
+inline PIX* pixDilateBrickSIMD(PIX* pixd, PIX* pixs, int hsize, int vsize) {
+  using namespace binary_morph;
+  if (!can_morph(pixd, pixs, hsize, vsize)) {
+    return pixDilateBrick(pixd, pixs, hsize, vsize);
+  }
+  if (!pixd) {
+    pixd = pixCreateTemplate(pixs);
+  }
+  if (vsize > 1) {
+    return morph_columns_into(pixd, pixs, Op::Dilate, vsize);
+  }
+  morph_rows(pixd, pixs, {{Op::Dilate, hsize, true}});
+  return pixd;
+}
+
+inline PIX* pixOpenBrickSIMD(PIX* pixd, PIX* pixs, int hsize, int vsize) {
+  using namespace binary_morph;
+  if (!can_morph(pixd, pixs, hsize, vsize)) {
+    return pixOpenBrick(pixd, pixs, hsize, vsize);
+  }
+  if (!pixd) {
+    pixd = pixCreateTemplate(pixs);
+  }
+  if (vsize > 1) {
+    PIX* pixt = pixCreateTemplate(pixs);
+    morph_columns(pixt, pixs, Op::Erode, vsize);
+    morph_columns_into(pixd, pixt, Op::Dilate, vsize);
+    pixDestroy(&pixt);
+    return pixd;
+  }
+  morph_rows(pixd, pixs, {{Op::Erode, hsize, true}, {Op::Dilate, hsize, true}});
+  return pixd;
+}
+
+inline PIX* pixCloseSafeBrickSIMD(PIX* pixd, PIX* pixs, int hsize,
+                                  int vsize) {
+  using namespace binary_morph;
+  // Only horizontal safe closing is implemented here.
+  if (!can_morph(pixd, pixs, hsize, vsize) || vsize > 1) {
+    return pixCloseSafeBrick(pixd, pixs, hsize, vsize);
+  }
+  if (!pixd) {
+    pixd = pixCreateTemplate(pixs);
+  }
+  morph_rows(pixd, pixs,
+             {{Op::Dilate, hsize, true}, {Op::Erode, hsize, false}});
+  return pixd;
+}
+
+#endif  // OCRLIB_BINARY_MORPH_H
@@ -0,0 +1,414 @@
+// Plain C API for the OCR engine.
+//
+// This is an alternative to the Embind API for hosts that run the WASM binary
+// without a JS runtime, eg. Go (wazero) or Rust (wasmtime). All strings are
+// UTF-8. Inputs are read from, and results are written into, buffers in the
+// module's linear memory which the host allocates using the exported
+// `malloc` and releases using `free`.
+//
+// Functions that return `int32_t` return 0 (or a non-negative count) on
+// success and -1 on failure, in which case `ocrlib_engine_last_error` returns
+// a description of the error.
+//
+// Functions that copy a string into a caller-provided buffer behave like
+// `snprintf`: they return the full length of the string, excluding the
+// terminating NUL, and write at most `capacity - 1` bytes followed by a NUL.
+// If the return value is >= `capacity`, the output was truncated.
+
+#ifndef OCRLIB_CAPI_H
+#define OCRLIB_CAPI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ocrlib_engine ocrlib_engine;
+
+// Values for the `unit` argument of `ocrlib_engine_get_boxes`.
+// Keep these in sync with `TextUnit` in lib.cpp.
+enum {
+  OCRLIB_UNIT_WORD = 0,
+  OCRLIB_UNIT_LINE = 1,
+};
+
+// Values for `ocrlib_box.flags`.
+// Keep these in sync with `LayoutFlag` in lib.cpp.
+enum {
+  OCRLIB_START_OF_LINE = 1,
+  OCRLIB_END_OF_LINE = 2,
+};
+
+// Values for the `remove_underlines` argument of `ocrlib_engine_load_image`
+// and `ocrlib_engine_load_raw_image`.
+// Keep these in sync with `UnderlineMode` in lib.cpp.
+enum {
+  OCRLIB_UNDERLINES_KEEP = 0,
+  OCRLIB_UNDERLINES_REMOVE = 1,
+  // Remove underlines only if the image appears to contain some. This uses a
+  // quick check for long horizontal strokes, which is much cheaper than
+  // removing underlines.
+  OCRLIB_UNDERLINES_AUTO = 2,
+};
+
+// Values for `ocrlib_preprocess_step.op`.
+// Keep these in sync with `PreprocessOp` in lib.cpp.
+enum {
+  // Correct small rotations of the page. The skew is searched for on a binary
+  // copy of the image reduced by a factor of `value`, which is 1, 2 or 4.
+  // Defaults to 2. The measured skew is returned by `ocrlib_engine_get_skew`.
+  OCRLIB_PREPROCESS_DESKEW = 0,
+  // Scale the image to `value` DPI. Does nothing if the image does not
+  // specify its resolution.
+  OCRLIB_PREPROCESS_SCALE_TO_DPI = 1,
+  // Apply a `value` x `value` median filter, or for binary images, remove
+  // specks smaller than `value` pixels in both directions. Defaults to 3.
+  OCRLIB_PREPROCESS_DENOISE = 2,
+  // Normalize contrast in tiles of `value` x `value` pixels, converting the
+  // image to greyscale. Defaults to 50. Does nothing to binary images.
+  OCRLIB_PREPROCESS_NORMALIZE_CONTRAST = 3,
+  // Remove `value` pixels from each edge of the image.
+  OCRLIB_PREPROCESS_REMOVE_BORDER = 4,
+};
+
+// An image preprocessing operation. A `value` of zero selects the default
+// for operations that have one.
+typedef struct ocrlib_preprocess_step {
+  int32_t op;
+  float value;
+} ocrlib_preprocess_step;
+
+// Options for `ocrlib_engine_load_image_with_options` and
+// `ocrlib_engine_load_raw_image_with_options`.
+typedef struct ocrlib_load_options {
+  // One of the `OCRLIB_UNDERLINES_*` values.
+  int32_t remove_underlines;
+  // Operations applied to the image, in order, before underline removal.
+  const ocrlib_preprocess_step* preprocess;
+  size_t preprocess_count;
+  // If non-zero, detect the orientation of the page and rotate it upright
+  // before preprocessing. See `ocrlib_engine_get_applied_rotation`.
+  int32_t auto_orient;
+} ocrlib_load_options;
+
+// Bounding box, layout flags and (optionally) text of a word or line.
+typedef struct ocrlib_box {
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+  int32_t flags;
+  // Confidence score in [0, 1]. Zero if text was not requested.
+  float confidence;
+  // Location of this item's UTF-8 text in the text buffer passed to
+  // `ocrlib_engine_get_boxes`, or in the string table of a packed buffer. The
+  // text is not NUL-terminated.
+  uint32_t text_offset;
+  uint32_t text_length;
+} ocrlib_box;
+
+// Header at the start of a packed box buffer, as returned by the Embind
+// `getBoundingBoxesPacked` and `getTextBoxesPacked` methods.
+//
+// The header is followed by `count` records of type `ocrlib_box` starting at
+// `records_offset`, and a table of UTF-8 strings starting at
+// `strings_offset`. The `text_offset` of each record is relative to the start
+// of the string table. All values are little-endian.
+typedef struct ocrlib_packed_boxes_header {
+  uint32_t count;
+  uint32_t record_size;
+  uint32_t records_offset;
+  uint32_t strings_offset;
+  uint32_t strings_size;
+} ocrlib_packed_boxes_header;
+
+// Bit flags for the `formats` argument of `ocrlib_engine_get_results`.
+// Keep these in sync with `ResultFormat` in lib.cpp.
+enum {
+  OCRLIB_RESULT_TEXT = 1,
+  OCRLIB_RESULT_WORD_BOXES = 2,
+  OCRLIB_RESULT_LINE_BOXES = 4,
+  OCRLIB_RESULT_HOCR = 8,
+};
+
+// Header at the start of the buffer returned by `ocrlib_engine_get_results`
+// and the Embind `getResults` method.
+//
+// Each output is stored in a section of the buffer starting at a 4-byte
+// aligned offset. Outputs which were not requested have a size of zero. The
+// text and hOCR sections hold UTF-8 strings which are not NUL-terminated. The
+// word and line box sections each hold a packed box buffer, with offsets
+// relative to the start of the section.
+typedef struct ocrlib_results_header {
+  uint32_t text_offset;
+  uint32_t text_size;
+  uint32_t hocr_offset;
+  uint32_t hocr_size;
+  uint32_t words_offset;
+  uint32_t words_size;
+  uint32_t lines_offset;
+  uint32_t lines_size;
+} ocrlib_results_header;
+
+// A rectangle in image coordinates. `right` and `bottom` are exclusive.
+typedef struct ocrlib_rect {
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+} ocrlib_rect;
+
+// Header at the start of the buffer returned by
+// `ocrlib_engine_recognize_regions` and the Embind `recognizeRegions` method.
+//
+// The header is followed by `count` records of type `ocrlib_region_results`
+// starting at `records_offset`, one for each requested region, in order.
+typedef struct ocrlib_regions_header {
+  uint32_t count;
+  uint32_t record_size;
+  uint32_t records_offset;
+} ocrlib_regions_header;
+
+typedef struct ocrlib_region_results {
+  // The region, clipped to the image.
+  int32_t left;
+  int32_t top;
+  int32_t right;
+  int32_t bottom;
+  // Location of the region's results, laid out as described by
+  // `ocrlib_results_header`, with offsets relative to `results_offset`. The
+  // location is 4-byte aligned.
+  uint32_t results_offset;
+  uint32_t results_size;
+} ocrlib_region_results;
+
+// Header at the start of the input and output buffers of
+// `ocrlib_engine_recognize_batch` and the Embind `recognizeBatch` method.
+//
+// The header is followed by `count` records starting at `records_offset`,
+// one for each image, in order. Input records have type
+// `ocrlib_batch_image` and output records have type `ocrlib_batch_result`.
+typedef struct ocrlib_batch_header {
+  uint32_t count;
+  uint32_t record_size;
+  uint32_t records_offset;
+} ocrlib_batch_header;
+
+typedef struct ocrlib_batch_image {
+  // Location of the image data, relative to the start of the input buffer.
+  uint32_t data_offset;
+  uint32_t data_size;
+  // If `width` is zero, the data is an encoded image in any format supported
+  // by `ocrlib_engine_load_image`. Otherwise it holds decoded pixels, in the
+  // format described by `ocrlib_engine_load_raw_image`.
+  int32_t width;
+  int32_t height;
+  int32_t bytes_per_pixel;
+  int32_t stride;
+} ocrlib_batch_image;
+
+typedef struct ocrlib_batch_result {
+  // Zero if the image was recognized, or non-zero if it could not be decoded
+  // or recognized, in which case the results are empty.
+  int32_t status;
+  // Location of the image's results, laid out as described by
+  // `ocrlib_results_header`, with offsets relative to `results_offset`. The
+  // location is 4-byte aligned.
+  uint32_t results_offset;
+  uint32_t results_size;
+} ocrlib_batch_result;
+
+// Callback that receives recognition progress as a percentage.
+typedef void (*ocrlib_progress_callback)(int32_t percentage, void* user_data);
+
+// Copy the Tesseract version string into `buf`.
+size_t ocrlib_version(char* buf, size_t capacity);
+
+ocrlib_engine* ocrlib_engine_create(void);
+void ocrlib_engine_destroy(ocrlib_engine* engine);
+
+// Copy the message for the last failed call on `engine` into `buf`.
+size_t ocrlib_engine_last_error(const ocrlib_engine* engine, char* buf,
+                                size_t capacity);
+
+// Load a `.traineddata` model for the language `lang`.
+int32_t ocrlib_engine_load_model(ocrlib_engine* engine, const uint8_t* data,
+                                 size_t size, const char* lang);
+
+int32_t ocrlib_engine_set_variable(ocrlib_engine* engine, const char* name,
+                                   const char* value);
+
+// Copy the value of a Tesseract configuration variable into `buf`. Returns -1
+// if the variable does not exist.
+int32_t ocrlib_engine_get_variable(ocrlib_engine* engine, const char* name,
+                                   char* buf, size_t capacity);
+
+// Decode an encoded image (eg. PNG, JPEG) and load it.
+int32_t ocrlib_engine_load_image(ocrlib_engine* engine, const uint8_t* data,
+                                 size_t size, int32_t remove_underlines);
+
+// Load already-decoded pixels. `bytes_per_pixel` is 0 (1bpp, one bits are
+// white), 1 (grey), 3 (RGB) or 4 (RGBA).
+int32_t ocrlib_engine_load_raw_image(ocrlib_engine* engine,
+                                     const uint8_t* pixels, size_t size,
+                                     int32_t width, int32_t height,
+                                     int32_t bytes_per_pixel, int32_t stride,
+                                     int32_t remove_underlines);
+
+// Variants of `ocrlib_engine_load_image` and `ocrlib_engine_load_raw_image`
+// that can also preprocess the image. The preprocessing happens after the
+// image is decoded, without further copies of the image.
+int32_t ocrlib_engine_load_image_with_options(ocrlib_engine* engine,
+                                              const uint8_t* data, size_t size,
+                                              const ocrlib_load_options* options);
+int32_t ocrlib_engine_load_raw_image_with_options(
+    ocrlib_engine* engine, const uint8_t* pixels, size_t size, int32_t width,
+    int32_t height, int32_t bytes_per_pixel, int32_t stride,
+    const ocrlib_load_options* options);
+
+void ocrlib_engine_clear_image(ocrlib_engine* engine);
+
+// Limit the memory used to load and process each image to roughly `bytes`,
+// not counting the model. Larger images are scaled down when loaded, JPEGs
+// while they are decoded. Zero, the default, means no limit.
+void ocrlib_engine_set_memory_budget(ocrlib_engine* engine, size_t bytes);
+
+// Recognize images larger than `size` pixels in either dimension in tiles of
+// `size` x `size` pixels that overlap by `overlap` pixels, and merge the
+// results. This bounds memory use by the tile size rather than the page
+// size, and tiles are recognized concurrently in the multi-threaded build.
+// The overlap should be larger than any word. Zero or less selects
+// `size / 8`. A `size` of zero, the default, disables tiling.
+//
+// Layout analysis of tiled images is done together with recognition. hOCR
+// output is still produced from the whole page.
+void ocrlib_engine_set_tile_size(ocrlib_engine* engine, int32_t size,
+                                 int32_t overlap);
+
+// Get the factor by which the current image was scaled down to fit the
+// memory budget, or 1 if it was not. Divide the coordinates of results by
+// this to get coordinates in the original image.
+int32_t ocrlib_engine_get_image_scale(ocrlib_engine* engine, float* scale);
+
+// Perform layout analysis and text recognition on the current image, if not
+// already done. `progress` may be NULL.
+int32_t ocrlib_engine_recognize(ocrlib_engine* engine,
+                                ocrlib_progress_callback progress,
+                                void* user_data);
+
+// Copy the page text into `buf`, recognizing the image first if needed.
+int32_t ocrlib_engine_get_text(ocrlib_engine* engine, char* buf,
+                               size_t capacity);
+
+// Copy the page text in hOCR format into `buf`, recognizing the image first
+// if needed.
+int32_t ocrlib_engine_get_hocr(ocrlib_engine* engine, char* buf,
+                               size_t capacity);
+
+// Get the words or lines on the page.
+//
+// If `with_text` is zero, only layout analysis is performed. Otherwise the
+// image is recognized first and the text of each item is written to `text`.
+//
+// Up to `max_boxes` items are written to `boxes` and the total number of
+// items is returned. `*text_size` is set to the number of bytes needed to hold
+// the text of all items. If either buffer was too small, call again with
+// larger buffers.
+int32_t ocrlib_engine_get_boxes(ocrlib_engine* engine, int32_t unit,
+                                int32_t with_text, ocrlib_box* boxes,
+                                size_t max_boxes, char* text,
+                                size_t text_capacity, size_t* text_size);
+
+// Get any combination of the page text, word boxes, line boxes and hOCR,
+// recognizing the image first if needed. This is cheaper than fetching each
+// format separately.
+//
+// Returns the size of the results buffer, laid out as described by
+// `ocrlib_results_header`. If this is larger than `capacity`, nothing is
+// written and the results are kept, so that calling again with a larger
+// buffer and the same `formats` does not need to produce them again.
+int32_t ocrlib_engine_get_results(ocrlib_engine* engine, int32_t formats,
+                                  uint8_t* buf, size_t capacity);
+
+// Recognize each of `regions` of the current image on its own, and get the
+// outputs selected by `formats` for each. This is much cheaper than
+// recognizing the whole page when only a few parts of it are needed. Box
+// coordinates are relative to the page.
+//
+// Returns the size of the results buffer, laid out as described by
+// `ocrlib_regions_header`. If this is larger than `capacity`, nothing is
+// written and the results are kept, so that calling again with a larger
+// buffer and the same arguments does not need to produce them again.
+int32_t ocrlib_engine_recognize_regions(ocrlib_engine* engine,
+                                        const ocrlib_rect* regions,
+                                        size_t count, int32_t formats,
+                                        uint8_t* buf, size_t capacity);
+
+// Recognize the text in each of `lines` of the current image. These are
+// boxes around single lines of text that the caller has already found, eg.
+// with a text detector, so page layout analysis is skipped. This is much
+// cheaper than recognizing the whole page.
+//
+// Returns the size of the results buffer, a packed box buffer as described
+// by `ocrlib_packed_boxes_header` with one record per line, in order. Each
+// record holds the line's box clipped to the image, its text and its mean
+// confidence. If the size is larger than `capacity`, nothing is written and
+// the results are kept, so that calling again with a larger buffer and the
+// same lines does not recognize them again.
+int32_t ocrlib_engine_recognize_lines(ocrlib_engine* engine,
+                                      const ocrlib_rect* lines, size_t count,
+                                      uint8_t* buf, size_t capacity);
+
+// Recognize a batch of small images, such as text fields cropped from a
+// form, and get the outputs selected by `formats` for each. `input` holds an
+// `ocrlib_batch_header` followed by `ocrlib_batch_image` records and the
+// image data. This avoids the setup cost of loading and recognizing each
+// image in a separate call.
+//
+// `psm` is a Tesseract page segmentation mode used for every image, such as
+// 7 for a single line of text, or -1 to use the engine's current mode. The
+// current image, if any, and its results are kept.
+//
+// Returns the size of the results buffer, which starts with an
+// `ocrlib_batch_header` followed by `ocrlib_batch_result` records, or -1 if
+// `input` is malformed or `psm` is invalid. If the size is larger than
+// `capacity`, nothing is written and the results are kept, so that calling
+// again with a larger buffer returns them without recognizing the images
+// again. The kept results are only returned if `input` is the same buffer,
+// at the same address and unchanged, with the same size, `psm` and
+// `formats`. The buffer's contents are not compared. The kept results are
+// discarded by any other call that produces results.
+int32_t ocrlib_engine_recognize_batch(ocrlib_engine* engine,
+                                      const uint8_t* input, size_t size,
+                                      int32_t psm, int32_t formats,
+                                      uint8_t* buf, size_t capacity);
+
+// Estimate the orientation of the current image.
+int32_t ocrlib_engine_get_orientation(ocrlib_engine* engine,
+                                      int32_t* rotation, float* confidence);
+
+// Return the clockwise rotation, in degrees, that the `auto_orient` load
+// option detected in the current image and corrected, or 0 if none was.
+// The rotation is only corrected when Leptonica is confident in it.
+int32_t ocrlib_engine_get_applied_rotation(ocrlib_engine* engine);
+
+// Get the skew that the `OCRLIB_PREPROCESS_DESKEW` step measured when the
+// current image was loaded, in degrees clockwise, and Leptonica's confidence
+// score for it. The image is only rotated if the confidence is at least 3 and
+// the angle at least 0.1 degrees. Both are zero if the image was not
+// deskewed.
+int32_t ocrlib_engine_get_skew(ocrlib_engine* engine, float* angle,
+                               float* confidence);
+
+// Return the engine that was created, with the model already loaded, when the
+// snapshot build (`tesseract-core-snapshot.wasm`) was made. Only exported by
+// that build.
+ocrlib_engine* ocrlib_snapshot_engine(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // OCRLIB_CAPI_H
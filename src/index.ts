@@ -2,15 +2,31 @@ export { OCRClient } from "./ocr-client";
 
 export type { OCRClientInit } from "./ocr-client";
 
-export { createOCREngine, layoutFlags, supportsFastBuild } from "./ocr-engine";
+export {
+  createOCREngine,
+  layoutFlags,
+  supportsFastBuild,
+  supportsRelaxedSIMDBuild,
+  supportsThreadedBuild,
+} from "./ocr-engine";
 
 export type {
+  BatchLayout,
+  BatchResults,
   CreateOCREngineOptions,
   BoxItem,
   IntRect,
+  LoadImageOptions,
   OCREngine,
   Orientation,
+  RegionResults,
+  PreprocessOp,
+  PreprocessStep,
   ProgressListener,
+  RecognizeBatchOptions,
+  ResultFormat,
+  Results,
+  Skew,
   TextItem,
   TextUnit,
 } from "./ocr-engine";
@@ -1,19 +1,38 @@
+// Define OCRLIB_NO_EMBIND to build only the C API in capi.h, without the
+// Embind bindings and the JS imports that they require. This is intended for
+// standalone WASI hosts.
+#ifndef OCRLIB_NO_EMBIND
 #include <emscripten/bind.h>
+#endif
 #include <emscripten/emscripten.h>
 #include <leptonica/allheaders.h>
 #include <tesseract/baseapi.h>
 #include <tesseract/ocrclass.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
 #include <format>
+#include <functional>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
+#include "binary-morph.h"
+#include "capi.h"
+#include "thread-pool.h"
+
 struct IntRect {
   int left = 0;
   int right = 0;
   int top = 0;
   int bottom = 0;
+
+  bool operator==(const IntRect&) const = default;
 };
 
 enum LayoutFlag {
@@ -35,6 +54,15 @@ struct Orientation {
   float confidence = 0.0f;
 };
 
+// Skew of an image, as measured by the deskew preprocessing step.
+struct Skew {
+  // Angle in degrees. Positive angles are clockwise.
+  float angle = 0.0f;
+  // Leptonica's confidence score for the angle. The image is only rotated if
+  // this is at least 3 and the angle is at least 0.1 degrees.
+  float confidence = 0.0f;
+};
+
 struct GetVariableResult {
   bool success;
   std::string value;
@@ -45,6 +73,60 @@ enum class TextUnit {
   Line,
 };
 
+// How underlines are handled when loading an image.
+// Keep these in sync with `OCRLIB_UNDERLINES_*` in capi.h.
+enum class UnderlineMode {
+  Keep = 0,
+  Remove = 1,
+  // Remove underlines only if the image appears to contain some.
+  Auto = 2,
+};
+
+// Image preprocessing operations.
+// Keep these in sync with `OCRLIB_PREPROCESS_*` in capi.h.
+enum class PreprocessOp {
+  // Correct small rotations of the page. The skew is searched for on a binary
+  // copy of the image reduced by a factor of `value`, which is 1, 2 or 4.
+  // Defaults to 2.
+  Deskew = 0,
+  // Scale the image to `value` DPI. Does nothing if the image has no
+  // resolution.
+  ScaleToDPI = 1,
+  // Apply a `value` x `value` median filter, or for binary images, remove
+  // specks smaller than `value` pixels in both directions. Defaults to 3.
+  Denoise = 2,
+  // Normalize contrast in tiles of `value` x `value` pixels, converting the
+  // image to greyscale. Defaults to 50. Does nothing to binary images.
+  NormalizeContrast = 3,
+  // Remove `value` pixels from each edge of the image.
+  RemoveBorder = 4,
+};
+
+struct PreprocessStep {
+  PreprocessOp op;
+  float value = 0;
+};
+
+struct LoadImageOptions {
+  UnderlineMode underlines = UnderlineMode::Keep;
+  // Detect the orientation of the page and rotate it upright, before
+  // preprocessing.
+  bool auto_orient = false;
+  // Operations applied to the image, in order, before underline removal.
+  std::vector<PreprocessStep> preprocess;
+};
+
+// Bit flags that select the outputs of `OCREngine::GetResults`.
+// Keep these in sync with `OCRLIB_RESULT_*` in capi.h.
+enum ResultFormat {
+  ResultText = 1,
+  ResultWordBoxes = 2,
+  ResultLineBoxes = 4,
+  ResultHOCR = 8,
+};
+
+using ResultFormats = int;
+
 template <class T>
 std::unique_ptr<T> unique_from_raw(T* ptr) {
   return std::unique_ptr<T>(ptr);
@@ -56,209 +138,666 @@ std::string string_from_raw(char* ptr) {
   return result;
 }
 
-auto iterator_level_from_unit(TextUnit unit) {
-  tesseract::PageIteratorLevel level;
-  if (unit == TextUnit::Line) {
-    return tesseract::RIL_TEXTLINE;
-  } else if (unit == TextUnit::Word) {
-    return tesseract::RIL_WORD;
-  } else {
-    return tesseract::RIL_SYMBOL;
+/**
+ * Create a Leptonica Pix from a buffer of already-decoded pixels.
+ *
+ * The pixel formats match `TessBaseAPI::SetImage(const unsigned char*, ...)`:
+ * `bytes_per_pixel` is 1 for greyscale, 3 for RGB, 4 for RGBA (the alpha
+ * channel is ignored) or 0 for a binary image that is byte packed with the MSB
+ * of the first byte being the first pixel, and a one bit meaning white.
+ *
+ * Returns nullptr if the dimensions are invalid or the buffer is too small.
+ */
+PIX* pix_from_raw_pixels(const unsigned char* pixels, size_t size, int width,
+                         int height, int bytes_per_pixel, int stride) {
+  if (width <= 0 || height <= 0) {
+    return nullptr;
+  }
+  if (bytes_per_pixel != 0 && bytes_per_pixel != 1 && bytes_per_pixel != 3 &&
+      bytes_per_pixel != 4) {
+    return nullptr;
+  }
+  size_t min_stride = bytes_per_pixel == 0 ? (size_t(width) + 7) / 8
+                                           : size_t(width) * bytes_per_pixel;
+  if (stride < 0 || size_t(stride) < min_stride ||
+      size < size_t(stride) * (height - 1) + min_stride) {
+    return nullptr;
   }
-}
 
-typedef std::string OCRResult;
+  int depth = bytes_per_pixel == 0 ? 1 : bytes_per_pixel == 1 ? 8 : 32;
+  PIX* pix = pixCreateNoInit(width, height, depth);
+  if (pix == nullptr) {
+    return nullptr;
+  }
 
-using namespace emscripten;
+  l_uint32* line = pixGetData(pix);
+  int wpl = pixGetWpl(pix);
+  for (int y = 0; y < height; ++y, line += wpl, pixels += stride) {
+    switch (bytes_per_pixel) {
+      case 0:
+        // Leptonica uses one bits for black, so invert while copying. Words
+        // are stored MSB-first, so the bytes of each word need swapping on
+        // little-endian WASM.
+        for (int x = 0; x < (width + 7) / 8; ++x) {
+          SET_DATA_BYTE(line, x, ~pixels[x]);
+        }
+        for (int x = (width + 7) / 8; x < wpl * 4; ++x) {
+          SET_DATA_BYTE(line, x, 0);
+        }
+        break;
+      case 1:
+        for (int x = 0; x < width; ++x) {
+          SET_DATA_BYTE(line, x, pixels[x]);
+        }
+        break;
+      case 3:
+        for (int x = 0; x < width; ++x) {
+          const unsigned char* rgb = pixels + x * 3;
+          composeRGBPixel(rgb[0], rgb[1], rgb[2], line + x);
+        }
+        break;
+      case 4:
+        for (int x = 0; x < width; ++x) {
+          const unsigned char* rgba = pixels + x * 4;
+          line[x] = (l_uint32(rgba[0]) << 24) | (l_uint32(rgba[1]) << 16) |
+                    (l_uint32(rgba[2]) << 8) | rgba[3];
+        }
+        break;
+    }
+  }
+  if (bytes_per_pixel == 0) {
+    // The bits past the right edge of the image in each row's last byte were
+    // inverted along with the pixels. Clear them, as some Leptonica
+    // operations read whole words.
+    binary_morph::clear_row_padding(pix);
+  }
+  return pix;
+}
 
-class ProgressMonitor : public tesseract::ETEXT_DESC {
- public:
-  ProgressMonitor(const emscripten::val& callback) : js_callback_(callback) {
-    progress_callback2 = progress_handler;
+/**
+ * Estimate the memory needed to load a `width` x `height` image of depth
+ * `depth` and have Tesseract process it.
+ *
+ * Besides the image itself, Tesseract keeps an 8bpp grey copy, an 8bpp
+ * thresholds image and a 1bpp binary image of the page, and makes smaller
+ * images during layout analysis. This is a rough estimate which doesn't
+ * include the model.
+ */
+size_t estimate_page_memory(int width, int height, int depth) {
+  size_t pixels = size_t(width) * height;
+  return pixels * depth / 8 + pixels * 5 / 2;
+}
+
+/**
+ * Return the factor by which to scale an image so that an estimated
+ * `required` bytes fits in `budget` bytes, or 1 if it fits already or there
+ * is no budget.
+ */
+float scale_for_budget(size_t budget, size_t required) {
+  if (budget == 0 || required <= budget) {
+    return 1.0f;
   }
+  // Memory use is proportional to the number of pixels.
+  return std::sqrt(double(budget) / required);
+}
 
-  void ProgressChanged(int percentage) {
-    if (!js_callback_.isUndefined()) {
-      js_callback_(percentage);
+/**
+ * Apply a preprocessing step to `pix`, taking ownership of it. Returns the
+ * output image, which may be `pix` itself, or nullptr if the step fails.
+ * Deskewing sets `skew` to the measured skew.
+ *
+ * `pix` must be 1, 8 or 32bpp without a colormap.
+ */
+PIX* apply_preprocess_step(PIX* pix, const PreprocessStep& step, Skew& skew) {
+  int depth = pixGetDepth(pix);
+  PIX* pixd = nullptr;
+
+  switch (step.op) {
+    case PreprocessOp::Deskew: {
+      int reduction = step.value > 0 ? step.value : 2;
+      if (reduction != 1 && reduction != 2 && reduction != 4) {
+        pixDestroy(&pix);
+        return nullptr;
+      }
+      // Returns a clone of `pix` if the skew is too small to correct.
+      skew = {};
+      pixd = pixFindSkewAndDeskew(pix, reduction, &skew.angle,
+                                  &skew.confidence);
+      break;
+    }
+    case PreprocessOp::ScaleToDPI: {
+      int res = pixGetXRes(pix);
+      if (res <= 0 || step.value <= 0 || std::abs(step.value - res) < 1) {
+        return pix;
+      }
+      float scale = step.value / res;
+      pixd = pixScale(pix, scale, scale);
+      break;
+    }
+    case PreprocessOp::Denoise: {
+      int size = step.value > 0 ? step.value : 3;
+      if (depth == 1) {
+        pixd = pixSelectBySize(pix, size, size, 8, L_SELECT_IF_EITHER,
+                               L_SELECT_IF_GTE, nullptr);
+      } else {
+        pixd = pixMedianFilter(pix, size, size);
+      }
+      break;
+    }
+    case PreprocessOp::NormalizeContrast: {
+      if (depth == 1) {
+        return pix;
+      }
+      int tile_size = step.value > 0 ? step.value : 50;
+      if (depth == 32) {
+        pixd = pixConvertRGBToLuminance(pix);
+        pixDestroy(&pix);
+        pix = pixd;
+        if (!pix) {
+          return nullptr;
+        }
+      }
+      // Normalizes `pix` in place.
+      pixd = pixContrastNorm(pix, pix, tile_size, tile_size, 50, 2, 2);
+      break;
+    }
+    case PreprocessOp::RemoveBorder: {
+      int border = step.value;
+      if (border <= 0) {
+        return pix;
+      }
+      if (2 * border >= pixGetWidth(pix) || 2 * border >= pixGetHeight(pix)) {
+        pixDestroy(&pix);
+        return nullptr;
+      }
+      pixd = pixRemoveBorder(pix, border);
+      break;
     }
   }
 
- private:
-  static bool progress_handler(tesseract::ETEXT_DESC* monitor, int left,
-                               int right, int top, int bottom) {
-    static_cast<ProgressMonitor*>(monitor)->ProgressChanged(monitor->progress);
-    return true;
+  if (pixd != pix) {
+    pixDestroy(&pix);
   }
-  emscripten::val js_callback_;
-};
+  return pixd;
+}
 
 /**
- * ByteView mallocs some bytes and exposes the memory via emscripten::typed_memory_view.
+ * Return a 1bpp copy of `pix` if it is an 8bpp or 32bpp image whose pixels are
+ * all black or white, or nullptr otherwise.
+ *
+ * Tesseract thresholds 8bpp and 32bpp images itself, which for such images
+ * produces the same binary image, but also keeps page-sized grey and
+ * threshold images that are only useful for images with shades of grey.
+ * Loading the 1bpp copy instead skips that work.
  */
-class ByteView {
- public:
-  ByteView(size_t size) {
-    size_ = size;
-    bytes_ = (const unsigned char *) malloc(size);
+PIX* binary_from_two_level(PIX* pix) {
+  int depth = pixGetDepth(pix);
+  if ((depth != 8 && depth != 32) || pixGetColormap(pix)) {
+    return nullptr;
   }
 
-  ~ByteView() { free((void *) bytes_); }
+  int width = pixGetWidth(pix);
+  int height = pixGetHeight(pix);
+  PIX* pixb = pixCreate(width, height, 1);
+  if (!pixb) {
+    return nullptr;
+  }
+  pixCopyResolution(pixb, pix);
+
+  // The alpha channel of 32bpp images is ignored.
+  const l_uint32 white = depth == 8 ? 0xff : 0xffffff;
+
+  l_uint32* line = pixGetData(pix);
+  int wpl = pixGetWpl(pix);
+  l_uint32* line_b = pixGetData(pixb);
+  int wpl_b = pixGetWpl(pixb);
+  for (int y = 0; y < height; y++, line += wpl, line_b += wpl_b) {
+    for (int x = 0; x < width; x++) {
+      l_uint32 value = depth == 8 ? GET_DATA_BYTE(line, x) : line[x] >> 8;
+      if (value == 0) {
+        SET_DATA_BIT(line_b, x);
+      } else if (value != white) {
+        pixDestroy(&pixb);
+        return nullptr;
+      }
+    }
+  }
+  return pixb;
+}
 
-  emscripten::val Data() const {
-    return emscripten::val(emscripten::typed_memory_view(size_, bytes_));
+/**
+ * Return a binarized copy of `pix`, at half resolution if `half_scale` is
+ * true, using a single Otsu threshold for the whole image. Returns nullptr on
+ * failure.
+ *
+ * This is a cheap approximation of Tesseract's thresholding for quick checks
+ * that are made before the image is handed to Tesseract.
+ */
+PIX* binarize_otsu(PIX* pix, bool half_scale) {
+  if (!half_scale && pixGetDepth(pix) == 1) {
+    return pixClone(pix);
+  }
+  PIX* pixg;
+  if (half_scale && pixGetDepth(pix) == 32) {
+    pixg = pixScaleRGBToGray2(pix, 0.3, 0.59, 0.11);
+  } else {
+    pixg = pixConvertTo8(pix, 0);
+    if (pixg && half_scale) {
+      auto pixs = pixScaleAreaMap2(pixg);
+      pixDestroy(&pixg);
+      pixg = pixs;
+    }
   }
 
-  size_t Size() const { return size_; }
-  const unsigned char * Bytes() const { return bytes_; }
-  // OOM is true if malloc failed, presumably due to Out Of Memory
-  bool OOM() const { return bytes_ == nullptr; }
+  PIX* pixb = nullptr;
+  if (pixg) {
+    pixOtsuAdaptiveThreshold(pixg, pixGetWidth(pixg), pixGetHeight(pixg), 0,
+                             0, 0.0, nullptr, &pixb);
+    pixDestroy(&pixg);
+  }
+  return pixb;
+}
 
- private:
-  size_t size_;
-  const unsigned char *bytes_;
-};
+/**
+ * Return true if `pix` appears to contain underlines, ie. long horizontal
+ * strokes.
+ *
+ * This works on a binarized copy of the image at half resolution, and is much
+ * cheaper than `OCREngine::RemoveUnderlines`, so it is used to skip underline
+ * removal for images without any.
+ */
+bool has_underlines(PIX* pix) {
+  // Matches the `o60.1` opening that `RemoveUnderlines` uses to find
+  // underlines, at half resolution.
+  const int min_underline_length = 60 / 2;
+
+  auto pixb = binarize_otsu(pix, true /* half_scale */);
+  if (!pixb) {
+    // Let `RemoveUnderlines` decide.
+    return true;
+  }
 
-class OCREngine {
- public:
-  OCREngine() : tesseract_(new tesseract::TessBaseAPI()) {}
+  // Join strokes broken by a pixel, as `RemoveUnderlines` does using `c3.1`.
+  pixCloseSafeBrickSIMD(pixb, pixb, 2, 1);
 
-  ~OCREngine() { tesseract_->End(); }
+  bool found = false;
+  int height = pixGetHeight(pixb);
+  for (int y = 0; y < height && !found; y++) {
+    l_int32 run_length = 0;
+    pixFindMaxHorizontalRunOnLine(pixb, y, nullptr, &run_length);
+    found = run_length >= min_underline_length;
+  }
+  pixDestroy(&pixb);
 
-  std::string Version() const { return tesseract_->Version(); }
+  return found;
+}
 
-  OCRResult LoadModel(const ByteView& model, const std::string& lang) {
-    auto result = tesseract_->Init(
-        (const char *) model.Bytes(), model.Size(), lang.c_str(), tesseract::OEM_LSTM_ONLY,
-        nullptr /* configs */, 0 /* configs_size */, nullptr /* vars_vec */,
-        nullptr /* vars_values */, false /* set_only_non_debug_params */, nullptr /* reader */
-    );
-    if (result != 0) {
-      return OCRResult("Failed to load training data");
-    }
-    return {};
+/**
+ * Apply `op` to tiles of `pixs` concurrently on `pool`, and stitch the results
+ * into a new image of depth `depth`.
+ *
+ * The image is split into tiles of `tile_size` pixels square, with the last
+ * tile in each row and column taking the remainder. `tile_size` must be a
+ * multiple of 32, so that tiles of 1bpp and 8bpp outputs don't share words
+ * and can be written concurrently.
+ *
+ * `op` is given each tile with `overlap` pixels of context on every side,
+ * which is mirrored at the edges of the image as Leptonica's `PIXTILING` does.
+ * It must return an image of the same size, whose context is discarded, and
+ * be safe to call from several threads at once.
+ *
+ * Returns nullptr if `op` fails for any tile, or returns an image of the wrong
+ * size or depth.
+ */
+PIX* map_tiles(ThreadPool& pool, PIX* pixs, int tile_size, int overlap,
+               int depth, const std::function<PIX*(PIX*)>& op) {
+  int width = pixGetWidth(pixs);
+  int height = pixGetHeight(pixs);
+  int nx = std::max(1, width / tile_size);
+  int ny = std::max(1, height / tile_size);
+
+  auto pixd = pixCreate(width, height, depth);
+  if (!pixd) {
+    return nullptr;
   }
-
-  GetVariableResult GetVariable(const std::string& var_name) const {
-    auto name = var_name.c_str();
-    std::string val;
-    bool success = tesseract_->GetVariableAsString(name, &val);
-    if (!success) {
-      return {.success = false};
+  pixCopyResolution(pixd, pixs);
+
+  std::atomic<bool> failed = false;
+  pool.Run(nx * ny, [&](size_t index, size_t thread) {
+    int col = index % nx;
+    int row = index / nx;
+    int left = col * tile_size;
+    int top = row * tile_size;
+    int right = col + 1 == nx ? width : left + tile_size;
+    int bottom = row + 1 == ny ? height : top + tile_size;
+
+    // Clip the tile and whatever context the image has, then mirror the rest.
+    int clip_left = std::max(0, left - overlap);
+    int clip_top = std::max(0, top - overlap);
+    int clip_right = std::min(width, right + overlap);
+    int clip_bottom = std::min(height, bottom + overlap);
+    auto box = boxCreate(clip_left, clip_top, clip_right - clip_left,
+                         clip_bottom - clip_top);
+    auto pixc = pixClipRectangle(pixs, box, nullptr);
+    boxDestroy(&box);
+    PIX* pixt = nullptr;
+    if (pixc) {
+      pixt = pixAddMirroredBorder(
+          pixc, overlap - (left - clip_left), overlap - (clip_right - right),
+          overlap - (top - clip_top), overlap - (clip_bottom - bottom));
+      pixDestroy(&pixc);
     }
-    return {.success = true, .value = val};
-  }
 
-  OCRResult SetVariable(const std::string& var_name,
-                        const std::string& var_value) {
-    auto name = var_name.c_str();
-    auto value = var_value.c_str();
-    bool success = tesseract_->SetVariable(name, value);
-    if (!success) {
-      return OCRResult("Failed to set value for variable " + var_name);
+    PIX* pixr = pixt ? op(pixt) : nullptr;
+    bool same_size = pixr && pixGetWidth(pixr) == pixGetWidth(pixt) &&
+                     pixGetHeight(pixr) == pixGetHeight(pixt);
+    pixDestroy(&pixt);
+    if (!same_size || pixGetDepth(pixr) != depth) {
+      pixDestroy(&pixr);
+      failed = true;
+      return;
     }
+    pixRasterop(pixd, left, top, right - left, bottom - top, PIX_SRC, pixr,
+                overlap, overlap);
+    pixDestroy(&pixr);
+  });
 
-    return {};
+  if (failed) {
+    pixDestroy(&pixd);
   }
+  return pixd;
+}
 
-  // RemoveUnderlines removes underlines from the given image. Copies a lot.
-  PIX *RemoveUnderlines(PIX  *pix) {
-    // easy peasy very understandable underline removal with everybody's favorite Leptonica
-    // Copies the image at least 7 times but if the image isn't parsable without underline removal, what else can you do.
-    // Probably can be made more efficient but not by me.
-    // https://github.com/DanBloomberg/leptonica/blob/b667978e86c4bf74f7fdd75f833127d2de327550/prog/underlinetest.c
-    auto pixg = pixConvertTo8(pix, 0);
-    auto pixg2 = pixBackgroundNorm(pixg, NULL, NULL, 15, 15, 70, 105, 200, 5, 5);
-    PIX *pixb;
-    pixSauvolaBinarizeTiled(pixg2, 8, 0.34, 1, 1, NULL, &pixb);
-    pixDestroy(&pix);
-    pixDestroy(&pixg);
-    pixDestroy(&pixg2);
+/**
+ * Binarize the 8bpp image `pixs` using Sauvola's method with a half window
+ * of 8px, as Leptonica's underline removal example does.
+ *
+ * The image is binarized in tiles of about 512px, concurrently on `pool`,
+ * which limits the size of the mean and mean square images that each tile
+ * allocates. The mean square image is 32bpp. The tiles overlap by enough for
+ * the window, so the result is the same as `pixSauvolaBinarizeTiled` and
+ * binarizing the whole image.
+ */
+PIX* sauvola_binarize_tiles(ThreadPool& pool, PIX* pixs) {
+  const int half_window = 8;
+  const int tile_size = 512;
+  return map_tiles(pool, pixs, tile_size, half_window + 1, 1, [](PIX* pix) {
+    // Binarize with a mirrored border added, so that the result has the same
+    // size as the tile and its context. The context is enough for the window,
+    // so the border only affects the context, which is discarded.
+    PIX* pixt = nullptr;
+    pixSauvolaBinarize(pix, half_window, 0.34, 1 /* addborder */, NULL, NULL,
+                       NULL, &pixt);
+    return pixt;
+  });
+}
 
-    /* Get a seed image; try to have at least one pixel
-      * in each underline c.c  */
-    auto pixsd = pixMorphSequence(pixb, "c3.1 + o60.1", 0);
+/**
+ * Detect the orientation of the text in `pix` and return the clockwise
+ * rotation, in degrees, that the image has relative to upright text.
+ *
+ * Unlike `OCREngine::GetOrientation`, this only reports a rotation when
+ * Leptonica is confident in it, and returns 0 otherwise, as it is used to
+ * rotate images without the caller checking the result.
+ */
+int detect_rotation(PIX* pix) {
+  // Large images, eg. 300 DPI scans, are binarized at half resolution to
+  // save time. Text is then still large enough for `pixOrientDetect`, which
+  // looks for ascenders and descenders.
+  const int min_size_to_reduce = 2000;
+  bool half_scale = std::min(pixGetWidth(pix), pixGetHeight(pix)) >=
+                    min_size_to_reduce;
+  auto pixb = binarize_otsu(pix, half_scale);
+  if (!pixb) {
+    return 0;
+  }
+  float up_conf = 0;
+  float left_conf = 0;
+  l_int32 orient = L_TEXT_ORIENT_UNKNOWN;
+  if (!pixOrientDetect(pixb, &up_conf, &left_conf, 0 /* min_count */,
+                       0 /* debug */)) {
+    // Use Leptonica's default thresholds.
+    pixOrientDecision(up_conf, left_conf, 0, 0, &orient, 0 /* debug */);
+  }
+  pixDestroy(&pixb);
+
+  switch (orient) {
+    case L_TEXT_ORIENT_LEFT:
+      return 270;
+    case L_TEXT_ORIENT_DOWN:
+      return 180;
+    case L_TEXT_ORIENT_RIGHT:
+      return 90;
+    default:
+      return 0;
+  }
+}
 
-    /* Get a mask image for the underlines.
-      * The o30.1 tries to remove accidental connections to text. */
-    auto pixm = pixMorphSequence(pixb, "c7.1 + o30.1", 0);
+auto iterator_level_from_unit(TextUnit unit) {
+  tesseract::PageIteratorLevel level;
+  if (unit == TextUnit::Line) {
+    return tesseract::RIL_TEXTLINE;
+  } else if (unit == TextUnit::Word) {
+    return tesseract::RIL_WORD;
+  } else {
+    return tesseract::RIL_SYMBOL;
+  }
+}
 
-    /* Fill into the seed, clipping to the mask  */
-    pixSeedfillBinary(pixsd, pixsd, pixm, 8);
-    pixDestroy(&pixm);
+/**
+ * Read the bounding box and layout flags of the item for `unit` at the
+ * iterator's current position into `tr`. If `with_text` is true, also read the
+ * confidence score and return the item's text.
+ */
+std::unique_ptr<char[]> read_text_rect(const tesseract::ResultIterator& iter,
+                                       TextUnit unit, bool with_text,
+                                       TextRect& tr) {
+  auto level = iterator_level_from_unit(unit);
+  std::unique_ptr<char[]> text;
+  if (with_text) {
+    // Tesseract provides confidence as a percentage. Convert it to a score
+    // in [0, 1]
+    tr.confidence = iter.Confidence(level) * 0.01;
+    text.reset(iter.GetUTF8Text(level));
+  }
 
-    /* Small vertical dilation for better removal  */
-    auto pixsdd = pixMorphSequence(pixsd, "d1.3", 0);
-    pixDestroy(&pixsd);
+  if (unit < TextUnit::Line) {
+    if (iter.IsAtBeginningOf(tesseract::RIL_TEXTLINE)) {
+      tr.flags |= LayoutFlag::StartOfLine;
+    }
+    if (iter.IsAtFinalElement(tesseract::RIL_TEXTLINE, level)) {
+      tr.flags |= LayoutFlag::EndOfLine;
+    }
+  }
 
-    /* Subtract to get text without underlines  */
-    auto pixt = pixSubtract(NULL, pixb, pixsdd);
-    pixDestroy(&pixsdd);
-    pixDestroy(&pixb);
+  iter.BoundingBox(level, &tr.rect.left, &tr.rect.top, &tr.rect.right,
+                   &tr.rect.bottom);
+  return text;
+}
 
-    return pixt;
+/**
+ * Return true if text in blocks of this type is included in the page text.
+ * This matches the filtering in `TessBaseAPI::GetUTF8Text`.
+ */
+bool is_text_block(tesseract::PolyBlockType type) {
+  switch (type) {
+    case tesseract::PT_FLOWING_IMAGE:
+    case tesseract::PT_HEADING_IMAGE:
+    case tesseract::PT_PULLOUT_IMAGE:
+    case tesseract::PT_HORZ_LINE:
+    case tesseract::PT_VERT_LINE:
+      return false;
+    default:
+      return true;
   }
+}
 
-  OCRResult LoadImage(const ByteView& view, bool remove_underlines) {
-    // Unavoidable copy of our ByteView into a Leptonica Pix.
-    // Using pixGetData() instead like robert-knight/tesseract-wasm originally did is another option,
-    // but then Go would need to re encode images to Leptonica's Pix format in memory anyway.
-    auto pix = pixReadMem(view.Bytes(), view.Size());
-    if (pix == nullptr) {
-      return OCRResult("pixReadMem failed");
-    }
+using BoxVisitor = std::function<void(TextRect&, const char* text)>;
 
-    if (remove_underlines) {
-      pix = RemoveUnderlines(pix);
+/**
+ * Walk the results in `iter` once, at word level, and produce any of the page
+ * text, words and lines. Empty outputs are skipped.
+ *
+ * The page text is built from the text of each line, which is what
+ * `TessBaseAPI::GetUTF8Text` does via `ResultIterator::GetUTF8Text(RIL_PARA)`,
+ * so the result is identical to `GetUTF8Text`.
+ */
+void walk_results(tesseract::ResultIterator& iter, std::string* text,
+                  const BoxVisitor& on_word, const BoxVisitor& on_line) {
+  do {
+    if ((text || on_line) && iter.IsAtBeginningOf(tesseract::RIL_TEXTLINE)) {
+      TextRect tr;
+      auto line_text = read_text_rect(iter, TextUnit::Line, true, tr);
+      const char* line_str = line_text ? line_text.get() : "";
+      if (on_line) {
+        on_line(tr, line_str);
+      }
+      if (text && !iter.Empty(tesseract::RIL_PARA) &&
+          is_text_block(iter.BlockType())) {
+        text->append(line_str);
+      }
+    }
+    if (on_word) {
+      TextRect tr;
+      auto word_text = read_text_rect(iter, TextUnit::Word, true, tr);
+      on_word(tr, word_text ? word_text.get() : "");
     }
+  } while (iter.Next(tesseract::RIL_WORD));
+}
 
-    // Initialize for layout analysis only if a model has not been loaded.
-    // This is a no-op if a model has been loaded.
-    tesseract_->InitForAnalysePage();
-    // Tesseract SetImage also copies the Pix for internal use, unfortunately.
-    // Doesn't seem like I can get rid of that without adding Tesseract patches. Possibly worth it...
-    tesseract_->SetImage(pix);
+/**
+ * Accumulates boxes and serializes them in the packed format described by
+ * `ocrlib_packed_boxes_header` in capi.h.
+ */
+class BoxPacker {
+ public:
+  void Add(const TextRect& tr, const char* text) {
+    auto text_length = strlen(text);
+    records_.push_back({
+        .left = tr.rect.left,
+        .top = tr.rect.top,
+        .right = tr.rect.right,
+        .bottom = tr.rect.bottom,
+        .flags = tr.flags,
+        .confidence = tr.confidence,
+        .text_offset = uint32_t(strings_.size()),
+        .text_length = uint32_t(text_length),
+    });
+    strings_.append(text, text_length);
+  }
 
-    layout_analysis_done_ = false;
-    ocr_done_ = false;
-    // Tesseract copies the Pix internally, so we should clean up immediately.
-    pixDestroy(&pix);
-    return {};
+  // Move all boxes by (`dx`, `dy`).
+  void Translate(int dx, int dy) {
+    for (auto& record : records_) {
+      record.left += dx;
+      record.right += dx;
+      record.top += dy;
+      record.bottom += dy;
+    }
   }
 
-  void ClearImage() {
-    tesseract_->Clear();
-    layout_analysis_done_ = false;
-    ocr_done_ = false;
+  // Size of the serialized buffer in bytes.
+  size_t Size() const { return StringsOffset() + strings_.size(); }
+
+  // Write the serialized buffer to `out`, which must have room for `Size()`
+  // bytes.
+  void WriteTo(unsigned char* out) const {
+    ocrlib_packed_boxes_header header = {
+        .count = uint32_t(records_.size()),
+        .record_size = sizeof(ocrlib_box),
+        .records_offset = sizeof(ocrlib_packed_boxes_header),
+        .strings_offset = uint32_t(StringsOffset()),
+        .strings_size = uint32_t(strings_.size()),
+    };
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + header.records_offset, records_.data(),
+           records_.size() * sizeof(ocrlib_box));
+    memcpy(out + header.strings_offset, strings_.data(), strings_.size());
   }
 
-  std::vector<TextRect> GetBoundingBoxes(TextUnit unit) {
-    if (!layout_analysis_done_) {
-      tesseract_->AnalyseLayout();
-      layout_analysis_done_ = true;
-    }
-    return GetBoxes(unit, false /* with_text */);
+ private:
+  size_t StringsOffset() const {
+    return sizeof(ocrlib_packed_boxes_header) +
+           records_.size() * sizeof(ocrlib_box);
   }
 
-  std::vector<TextRect> GetTextBoxes(TextUnit unit,
-                                     const emscripten::val& progress_callback) {
-    DoOCR(progress_callback);
-    return GetBoxes(unit, true /* with_text */);
+  std::vector<ocrlib_box> records_;
+  std::string strings_;
+};
+
+/**
+ * Holds the outputs selected by `formats` and serializes them in the format
+ * described by `ocrlib_results_header` in capi.h.
+ */
+struct ResultsPacker {
+  explicit ResultsPacker(ResultFormats formats = 0) : formats(formats) {}
+
+  // Size of the serialized buffer in bytes.
+  size_t Size() const {
+    ocrlib_results_header header;
+    return Layout(header);
   }
 
-  std::string GetText(const emscripten::val& progress_callback) {
-    DoOCR(progress_callback);
-    return string_from_raw(tesseract_->GetUTF8Text());
+  // Write the serialized buffer to `out`, which must have room for `Size()`
+  // bytes.
+  void WriteTo(unsigned char* out) const {
+    ocrlib_results_header header;
+    size_t size = Layout(header);
+    memset(out, 0, size);
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + header.text_offset, text.data(), header.text_size);
+    memcpy(out + header.hocr_offset, hocr.data(), header.hocr_size);
+    if (header.words_size) {
+      words.WriteTo(out + header.words_offset);
+    }
+    if (header.lines_size) {
+      lines.WriteTo(out + header.lines_offset);
+    }
   }
 
-  std::string GetHOCR(const emscripten::val& progress_callback) {
-    DoOCR(progress_callback);
-    auto hocr_body = string_from_raw(tesseract_->GetHOCRText(0));
+  ResultFormats formats;
+  std::string text;
+  std::string hocr;
+  BoxPacker words;
+  BoxPacker lines;
+
+ private:
+  // Fill in `header` and return the size of the serialized buffer.
+  size_t Layout(ocrlib_results_header& header) const {
+    // Sections are 4-byte aligned so that C hosts can read the box records
+    // in place.
+    auto align = [](size_t offset) { return (offset + 3) & ~size_t(3); };
+    header = {};
+    size_t offset = sizeof(header);
+    auto add_section = [&](bool present, size_t size, uint32_t& section_offset,
+                           uint32_t& section_size) {
+      section_offset = offset;
+      section_size = present ? size : 0;
+      offset = align(offset + section_size);
+    };
+    add_section(formats & ResultText, text.size(), header.text_offset,
+                header.text_size);
+    add_section(formats & ResultHOCR, hocr.size(), header.hocr_offset,
+                header.hocr_size);
+    add_section(formats & ResultWordBoxes, words.Size(), header.words_offset,
+                header.words_size);
+    add_section(formats & ResultLineBoxes, lines.Size(), header.lines_offset,
+                header.lines_size);
+    return offset;
+  }
+};
 
-    // The header and footer of the hOCR document are taken from
-    // `TessHOcrRenderer::BeginDocumentHandler` and
-    // `TessHOcrRenderer::EndDocumentHandler` respectively. We can't use that
-    // class directly because it expects to write to a file.
-    auto hocr_doc = std::format(R"(<?xml version="1.0" encoding="UTF-8"?>
+/**
+ * Return the text recognized by `api` as an hOCR document.
+ */
+std::string build_hocr(tesseract::TessBaseAPI& api) {
+  auto hocr_body = string_from_raw(api.GetHOCRText(0));
+
+  // The header and footer of the hOCR document are taken from
+  // `TessHOcrRenderer::BeginDocumentHandler` and
+  // `TessHOcrRenderer::EndDocumentHandler` respectively. We can't use that
+  // class directly because it expects to write to a file.
+  auto hocr_doc = std::format(R"(<?xml version="1.0" encoding="UTF-8"?>
 <!DOCTYPE html PUBLIC "-//W3C//DTD XHTML 1.0 Transitional//EN" "http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd">
 <html xmlns="http://www.w3.org/1999/xhtml" xml:lang="en" lang="en">
 <head>
@@ -271,20 +810,1274 @@ class OCREngine {
   {}
 </body>
 </html>)",
-                                tesseract_->Version(), hocr_body);
+                              api.Version(), hocr_body);
 
-    return hocr_doc;
-  }
+  return hocr_doc;
+}
 
-  Orientation GetOrientation() {
-    // Tesseract's orientation detection is part of the legacy (non-LSTM)
-    // engine, which is not compiled in to reduce binary size. Hence we use
-    // Leptonica's orientation detection instead. See comments for
-    // `pixOrientDetect` in the Leptonica source for details of how it works.
-    //
-    // The method is simplistic, and is designed for latin text, but it serves
-    // as a baseline that can be improved upon later.
-    auto pix = tesseract_->GetThresholdedImage();
+/**
+ * Produce any of the text, word boxes and line boxes recognized by `api` in a
+ * single walk over the results. Outputs which are null are skipped.
+ */
+void walk_api_results(tesseract::TessBaseAPI& api, std::string* text,
+                      BoxPacker* words, BoxPacker* lines) {
+  auto iter = unique_from_raw(api.GetIterator());
+  if (!iter) {
+    return;
+  }
+  BoxVisitor on_word;
+  BoxVisitor on_line;
+  if (words) {
+    on_word = [&](TextRect& tr, const char* text) { words->Add(tr, text); };
+  }
+  if (lines) {
+    on_line = [&](TextRect& tr, const char* text) { lines->Add(tr, text); };
+  }
+  walk_results(*iter, text, on_word, on_line);
+}
+
+/**
+ * Gather the outputs selected by `formats` from the results held by `api`.
+ */
+ResultsPacker collect_results(tesseract::TessBaseAPI& api,
+                              ResultFormats formats) {
+  ResultsPacker packer(formats);
+  if (formats & (ResultText | ResultWordBoxes | ResultLineBoxes)) {
+    walk_api_results(api, formats & ResultText ? &packer.text : nullptr,
+                     formats & ResultWordBoxes ? &packer.words : nullptr,
+                     formats & ResultLineBoxes ? &packer.lines : nullptr);
+  }
+  if (formats & ResultHOCR) {
+    packer.hocr = build_hocr(api);
+  }
+  return packer;
+}
+
+typedef std::string OCRResult;
+
+/**
+ * Load a trained model into `api` for text recognition.
+ */
+bool init_tesseract(tesseract::TessBaseAPI& api, const unsigned char* data,
+                    size_t size, const std::string& lang) {
+  auto result = api.Init(
+      (const char *) data, size, lang.c_str(), tesseract::OEM_LSTM_ONLY,
+      nullptr /* configs */, 0 /* configs_size */, nullptr /* vars_vec */,
+      nullptr /* vars_values */, false /* set_only_non_debug_params */, nullptr /* reader */
+  );
+  return result == 0;
+}
+
+/**
+ * Results of recognizing a page in parallel. See `OCREngine::RecognizeParallel`.
+ */
+struct PageResults {
+  std::string text;
+  std::vector<TextRect> words;
+  std::vector<TextRect> lines;
+};
+
+/**
+ * Part of a page that is recognized independently of the rest of the page
+ * when recognizing in parallel. This is a horizontal band of text lines from
+ * one block.
+ */
+struct PageRegion {
+  // Binary image of the region, masked to the outline of its block.
+  PIX* pix = nullptr;
+  // Position of the region's image in the page.
+  int left = 0;
+  int top = 0;
+  tesseract::PageSegMode psm = tesseract::PSM_SINGLE_BLOCK;
+  // True if this is the last region of its block.
+  bool ends_block = true;
+};
+
+/**
+ * A word recognized in one tile of a page. See `OCREngine::RecognizeTiled`.
+ */
+struct TileWord {
+  // Box in page coordinates, and text.
+  TextRect word;
+  // Indices of the word's line and block among those in the tile.
+  int line = 0;
+  int block = 0;
+};
+
+/**
+ * Results of recognizing one tile of a page.
+ */
+struct TileResults {
+  // Position of the tile in the grid of tiles.
+  int row = 0;
+  int col = 0;
+  // The part of the tile that it is responsible for. Tiles overlap, and an
+  // item found by several tiles is kept by the one whose core contains the
+  // center of the item.
+  IntRect core;
+  std::vector<TileWord> words;
+  // Boxes of the tile's lines in page coordinates, including words outside
+  // the core.
+  std::vector<IntRect> lines;
+  // Set if the tile could not be recognized.
+  bool failed = false;
+};
+
+/**
+ * Read the words in text blocks of `iter`, which holds the results for a
+ * tile whose top left corner is at (`left`, `top`) in the page, into `tile`.
+ */
+void read_tile_words(tesseract::ResultIterator& iter, int left, int top,
+                     TileResults& tile) {
+  auto to_page = [&](IntRect& rect) {
+    rect.left += left;
+    rect.right += left;
+    rect.top += top;
+    rect.bottom += top;
+  };
+
+  int block = -1;
+  bool in_text_block = false;
+  do {
+    if (iter.IsAtBeginningOf(tesseract::RIL_BLOCK)) {
+      block++;
+      in_text_block = is_text_block(iter.BlockType());
+    }
+    if (!in_text_block) {
+      continue;
+    }
+    if (iter.IsAtBeginningOf(tesseract::RIL_TEXTLINE)) {
+      IntRect rect;
+      iter.BoundingBox(tesseract::RIL_TEXTLINE, &rect.left, &rect.top,
+                       &rect.right, &rect.bottom);
+      to_page(rect);
+      tile.lines.push_back(rect);
+    }
+    TileWord tw{.line = int(tile.lines.size()) - 1, .block = block};
+    auto text = read_text_rect(iter, TextUnit::Word, true, tw.word);
+    tw.word.text = text ? text.get() : "";
+    to_page(tw.word.rect);
+    tile.words.push_back(std::move(tw));
+  } while (iter.Next(tesseract::RIL_WORD));
+}
+
+/**
+ * Merge the results of overlapping tiles, given in reading order of the
+ * tiles, into results for the whole page.
+ *
+ * Words are deduplicated by keeping each one only in the tile whose core
+ * contains its center. As long as the overlap between tiles is larger than
+ * any word, this keeps exactly one complete copy of each word. Lines that
+ * cross a seam are found by each tile, so the kept words of lines from
+ * neighboring tiles are joined when the lines overlap.
+ *
+ * Lines are ordered by the first tile, and then line, that they were found
+ * in. This is only an approximation of the page's reading order, and
+ * paragraphs are approximated by blocks.
+ */
+std::unique_ptr<PageResults> merge_tile_results(
+    const std::vector<TileResults>& tiles) {
+  // Part of a line that is within one tile's core.
+  struct Fragment {
+    size_t tile;
+    int line;
+    std::vector<const TileWord*> words;
+    size_t parent;  // For the union-find below.
+  };
+  std::vector<Fragment> fragments;
+
+  auto center_in = [](const IntRect& rect, const IntRect& core) {
+    int x = (rect.left + rect.right) / 2;
+    int y = (rect.top + rect.bottom) / 2;
+    return x >= core.left && x < core.right && y >= core.top &&
+           y < core.bottom;
+  };
+  for (size_t t = 0; t < tiles.size(); t++) {
+    for (const auto& tw : tiles[t].words) {
+      if (!center_in(tw.word.rect, tiles[t].core)) {
+        continue;
+      }
+      if (fragments.empty() || fragments.back().tile != t ||
+          fragments.back().line != tw.line) {
+        fragments.push_back({.tile = t, .line = tw.line,
+                             .parent = fragments.size()});
+      }
+      fragments.back().words.push_back(&tw);
+    }
+  }
+
+  auto find = [&](size_t i) {
+    while (fragments[i].parent != i) {
+      i = fragments[i].parent = fragments[fragments[i].parent].parent;
+    }
+    return i;
+  };
+  auto same_line = [&](const Fragment& a, const Fragment& b) {
+    const auto& ta = tiles[a.tile];
+    const auto& tb = tiles[b.tile];
+    if (a.tile == b.tile || std::abs(ta.row - tb.row) > 1 ||
+        std::abs(ta.col - tb.col) > 1) {
+      return false;
+    }
+    const auto& la = ta.lines[a.line];
+    const auto& lb = tb.lines[b.line];
+    int overlap_x = std::min(la.right, lb.right) - std::max(la.left, lb.left);
+    int overlap_y = std::min(la.bottom, lb.bottom) - std::max(la.top, lb.top);
+    int min_height = std::min(la.bottom - la.top, lb.bottom - lb.top);
+    return overlap_x > 0 && overlap_y * 2 >= min_height;
+  };
+
+  // Fragments of each tile are contiguous. Only compare fragments with those
+  // of the following neighboring tiles, as `same_line` rejects the rest, so
+  // that pages with hundreds of tiles don't compare every pair of fragments.
+  std::vector<size_t> tile_start(tiles.size() + 1, fragments.size());
+  for (size_t i = fragments.size(); i-- > 0;) {
+    tile_start[fragments[i].tile] = i;
+  }
+  for (size_t t = tiles.size(); t-- > 0;) {
+    tile_start[t] = std::min(tile_start[t], tile_start[t + 1]);
+  }
+  int cols = 0;
+  int rows = 0;
+  for (const auto& tile : tiles) {
+    cols = std::max(cols, tile.col + 1);
+    rows = std::max(rows, tile.row + 1);
+  }
+  std::vector<size_t> tile_at(rows * cols, tiles.size());
+  for (size_t t = 0; t < tiles.size(); t++) {
+    tile_at[tiles[t].row * cols + tiles[t].col] = t;
+  }
+
+  for (size_t t = 0; t < tiles.size(); t++) {
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        int row = tiles[t].row + dy;
+        int col = tiles[t].col + dx;
+        if (row < 0 || row >= rows || col < 0 || col >= cols) {
+          continue;
+        }
+        size_t u = tile_at[row * cols + col];
+        if (u >= tiles.size() || u <= t) {
+          continue;
+        }
+        for (size_t i = tile_start[t]; i < tile_start[t + 1]; i++) {
+          for (size_t j = tile_start[u]; j < tile_start[u + 1]; j++) {
+            if (same_line(fragments[i], fragments[j])) {
+              size_t a = find(i);
+              size_t b = find(j);
+              fragments[std::max(a, b)].parent = std::min(a, b);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Fragments are in reading order of tiles and lines, so each line's root
+  // is also its first fragment.
+  std::vector<std::vector<const TileWord*>> lines(fragments.size());
+  for (size_t i = 0; i < fragments.size(); i++) {
+    auto& words = lines[find(i)];
+    words.insert(words.end(), fragments[i].words.begin(),
+                 fragments[i].words.end());
+  }
+
+  auto page = std::make_unique<PageResults>();
+  const Fragment* prev_start = nullptr;
+  for (size_t i = 0; i < lines.size(); i++) {
+    auto& words = lines[i];
+    if (words.empty()) {
+      continue;
+    }
+    std::stable_sort(words.begin(), words.end(), [](auto a, auto b) {
+      return a->word.rect.left < b->word.rect.left;
+    });
+
+    // Start a new paragraph when the block changes.
+    const auto& start = fragments[i];
+    if (prev_start &&
+        (prev_start->tile != start.tile ||
+         prev_start->words.front()->block != start.words.front()->block)) {
+      page->text += "\n";
+    }
+    prev_start = &start;
+
+    TextRect line{.rect = words.front()->word.rect};
+    for (size_t w = 0; w < words.size(); w++) {
+      TextRect word = words[w]->word;
+      word.flags = 0;
+      if (w == 0) {
+        word.flags |= LayoutFlag::StartOfLine;
+      } else {
+        line.text += " ";
+      }
+      if (w + 1 == words.size()) {
+        word.flags |= LayoutFlag::EndOfLine;
+      }
+      line.rect.left = std::min(line.rect.left, word.rect.left);
+      line.rect.top = std::min(line.rect.top, word.rect.top);
+      line.rect.right = std::max(line.rect.right, word.rect.right);
+      line.rect.bottom = std::max(line.rect.bottom, word.rect.bottom);
+      line.confidence += word.confidence / words.size();
+      line.text += word.text;
+      page->words.push_back(std::move(word));
+    }
+    line.text += "\n";
+    page->text += line.text;
+    page->lines.push_back(std::move(line));
+  }
+  if (!page->text.empty()) {
+    page->text += "\n";
+  }
+  return page;
+}
+
+/**
+ * Callback that receives recognition progress as a percentage.
+ */
+using ProgressCallback = std::function<void(int)>;
+
+class ProgressMonitor : public tesseract::ETEXT_DESC {
+ public:
+  ProgressMonitor(const ProgressCallback& callback) : callback_(callback) {
+    progress_callback2 = progress_handler;
+  }
+
+  void ProgressChanged(int percentage) {
+    if (callback_) {
+      callback_(percentage);
+    }
+  }
+
+ private:
+  static bool progress_handler(tesseract::ETEXT_DESC* monitor, int left,
+                               int right, int top, int bottom) {
+    static_cast<ProgressMonitor*>(monitor)->ProgressChanged(monitor->progress);
+    return true;
+  }
+  ProgressCallback callback_;
+};
+
+/**
+ * ByteView mallocs some bytes and exposes the memory via emscripten::typed_memory_view.
+ */
+class ByteView {
+ public:
+  ByteView(size_t size) {
+    size_ = size;
+    bytes_ = (const unsigned char *) malloc(size);
+  }
+
+  ~ByteView() { free((void *) bytes_); }
+
+  ByteView(const ByteView&) = delete;
+  ByteView& operator=(const ByteView&) = delete;
+
+#ifndef OCRLIB_NO_EMBIND
+  emscripten::val Data() const {
+    return emscripten::val(emscripten::typed_memory_view(size_, bytes_));
+  }
+#endif
+
+  size_t Size() const { return size_; }
+  const unsigned char * Bytes() const { return bytes_; }
+  unsigned char* MutableBytes() { return (unsigned char*)bytes_; }
+  // OOM is true if malloc failed, presumably due to Out Of Memory
+  bool OOM() const { return bytes_ == nullptr; }
+
+ private:
+  size_t size_;
+  const unsigned char *bytes_;
+};
+
+class OCREngine {
+ public:
+  OCREngine() : tesseract_(new tesseract::TessBaseAPI()) {}
+
+  ~OCREngine() { tesseract_->End(); }
+
+  std::string Version() const { return tesseract_->Version(); }
+
+  OCRResult LoadModel(const ByteView& model, const std::string& lang) {
+    return LoadModel(model.Bytes(), model.Size(), lang);
+  }
+
+  OCRResult LoadModel(const unsigned char* data, size_t size,
+                      const std::string& lang) {
+    if (!init_tesseract(*tesseract_, data, size, lang)) {
+      model_loaded_ = false;
+      return OCRResult("Failed to load training data");
+    }
+    model_loaded_ = true;
+
+    // With threads, keep a copy of the model to load into the TessBaseAPI of
+    // each pool thread when the thread is first used. Loading them now would
+    // parse the model once per thread for engines that never recognize in
+    // parallel.
+    workers_.clear();
+    model_data_.clear();
+    auto& pool = GetPool();
+    if (pool.Size() > 1) {
+      model_data_.assign(data, data + size);
+      model_lang_ = lang;
+      workers_.resize(pool.Size());
+
+      // Loading a model can reset variables, so set them again, to give
+      // `tesseract_` the same settings as the workers.
+      for (const auto& [name, value] : variables_) {
+        tesseract_->SetVariable(name.c_str(), value.c_str());
+      }
+    }
+    return {};
+  }
+
+  GetVariableResult GetVariable(const std::string& var_name) const {
+    auto name = var_name.c_str();
+    std::string val;
+    bool success = tesseract_->GetVariableAsString(name, &val);
+    if (!success) {
+      return {.success = false};
+    }
+    return {.success = true, .value = val};
+  }
+
+  OCRResult SetVariable(const std::string& var_name,
+                        const std::string& var_value) {
+    auto name = var_name.c_str();
+    auto value = var_value.c_str();
+    bool success = tesseract_->SetVariable(name, value);
+    if (!success) {
+      return OCRResult("Failed to set value for variable " + var_name);
+    }
+
+    if (ThreadPool::DefaultSize() > 1) {
+      variables_[var_name] = var_value;
+      for (auto& worker : workers_) {
+        if (worker) {
+          worker->SetVariable(name, value);
+        }
+      }
+    }
+
+    return {};
+  }
+
+  // RemoveUnderlines removes underlines from the given image, taking
+  // ownership of it, and returns a binarized copy without underlines.
+  //
+  // This follows Leptonica's underline removal example, but frees each
+  // full-page image as soon as the next one is made and does the 1bpp
+  // morphology in place in two scratch images, so that no more than two
+  // 8bpp copies of the page are alive at once.
+  // https://github.com/DanBloomberg/leptonica/blob/b667978e86c4bf74f7fdd75f833127d2de327550/prog/underlinetest.c
+  PIX *RemoveUnderlines(PIX  *pix) {
+    // `pixConvertTo8` copies images that are already 8bpp greyscale.
+    PIX *pixg;
+    if (pixGetDepth(pix) == 8 && !pixGetColormap(pix)) {
+      pixg = pix;
+    } else {
+      pixg = pixConvertTo8(pix, 0);
+      pixDestroy(&pix);
+    }
+
+    auto& pool = GetPool();
+    auto background_norm = [](PIX* pix) {
+      return pixBackgroundNorm(pix, NULL, NULL, 15, 15, 70, 105, 200, 5, 5);
+    };
+
+    // With threads, normalize the background in tiles concurrently. The
+    // tiles are aligned to the 15px grid of the background map, and the
+    // overlap covers the map's 5-cell smoothing, so the tiles only differ
+    // from the whole image where the map has holes to fill. A tile that is
+    // too dark to estimate the background falls back to the whole image.
+    const int background_tile_size = 960;
+    PIX *pixn = nullptr;
+    if (pool.Size() > 1) {
+      pixn = map_tiles(pool, pixg, background_tile_size, 120, 8,
+                       background_norm);
+    }
+    if (!pixn) {
+      pixn = background_norm(pixg);
+    }
+    pixDestroy(&pixg);
+    if (!pixn) {
+      return nullptr;
+    }
+
+    // Binarize in tiles, concurrently if threads are available.
+    auto pixb = sauvola_binarize_tiles(pool, pixn);
+    pixDestroy(&pixn);
+    if (!pixb) {
+      return nullptr;
+    }
+
+    /* Get a seed image; try to have at least one pixel
+      * in each underline c.c  */
+    auto pixsd = pixCloseSafeBrickSIMD(NULL, pixb, 3, 1);
+    pixOpenBrickSIMD(pixsd, pixsd, 60, 1);
+
+    /* Get a mask image for the underlines.
+      * The o30.1 tries to remove accidental connections to text. */
+    auto pixm = pixCloseSafeBrickSIMD(NULL, pixb, 7, 1);
+    pixOpenBrickSIMD(pixm, pixm, 30, 1);
+
+    /* Fill into the seed, clipping to the mask. Leptonica's fill propagates
+      * along rows and columns in raster order, which doesn't suit SIMD. */
+    pixSeedfillBinary(pixsd, pixsd, pixm, 8);
+
+    /* Small vertical dilation for better removal. The mask is no longer
+      * needed, so its buffer is reused for the result. */
+    pixDilateBrickSIMD(pixm, pixsd, 1, 3);
+    pixDestroy(&pixsd);
+
+    /* Subtract to get text without underlines  */
+    pixSubtract(pixb, pixb, pixm);
+    pixDestroy(&pixm);
+
+    return pixb;
+  }
+
+  OCRResult LoadImage(const ByteView& view, const LoadImageOptions& options) {
+    return LoadImage(view.Bytes(), view.Size(), options);
+  }
+
+  OCRResult LoadImage(const unsigned char* data, size_t size,
+                      const LoadImageOptions& options) {
+    // Unavoidable copy of our ByteView into a Leptonica Pix.
+    // Using pixGetData() instead like robert-knight/tesseract-wasm originally did is another option,
+    // but then Go would need to re encode images to Leptonica's Pix format in memory anyway.
+    // Hosts that already have decoded pixels should use LoadRawImage instead.
+    //
+    // If the image would exceed the memory budget, JPEGs are reduced by up to
+    // 8x while decoding, which avoids ever holding the full-size image. Any
+    // further scaling happens in `LoadPix`.
+    PIX* pix = nullptr;
+    float decode_scale = 1.0f;
+    l_int32 format, width, height, bps, spp;
+    if (memory_budget_ > 0 &&
+        !pixReadHeaderMem(data, size, &format, &width, &height, &bps, &spp,
+                          nullptr) &&
+        format == IFF_JFIF_JPEG) {
+      int depth = spp == 1 ? bps : 32;
+      float scale = scale_for_budget(
+          memory_budget_, estimate_page_memory(width, height, depth));
+      int reduction = 1;
+      while (reduction < 8 && scale * reduction * 2 <= 1.0f) {
+        reduction *= 2;
+      }
+      if (reduction > 1) {
+        pix = pixReadMemJpeg(data, size, 0, reduction, nullptr, 0);
+        if (pix == nullptr) {
+          return OCRResult("pixReadMemJpeg failed");
+        }
+        // Leptonica keeps the resolution from the JPEG header.
+        pixSetResolution(pix, pixGetXRes(pix) / reduction,
+                         pixGetYRes(pix) / reduction);
+        decode_scale = float(pixGetWidth(pix)) / width;
+      }
+    }
+    if (pix == nullptr) {
+      pix = pixReadMem(data, size);
+    }
+    if (pix == nullptr) {
+      return OCRResult("pixReadMem failed");
+    }
+    return LoadPix(pix, options, decode_scale);
+  }
+
+  // LoadRawImage loads an image from already-decoded pixels, skipping the
+  // pixReadMem decode. See `pix_from_raw_pixels` for the supported formats.
+  OCRResult LoadRawImage(const ByteView& view, int width, int height,
+                         int bytes_per_pixel, int stride,
+                         const LoadImageOptions& options) {
+    return LoadRawImage(view.Bytes(), view.Size(), width, height,
+                        bytes_per_pixel, stride, options);
+  }
+
+  OCRResult LoadRawImage(const unsigned char* pixels, size_t size, int width,
+                         int height, int bytes_per_pixel, int stride,
+                         const LoadImageOptions& options) {
+    auto pix = pix_from_raw_pixels(pixels, size, width, height,
+                                   bytes_per_pixel, stride);
+    if (pix == nullptr) {
+      return OCRResult("Invalid raw image dimensions or format");
+    }
+    return LoadPix(pix, options);
+  }
+
+  void ClearImage() {
+    tesseract_->Clear();
+    layout_analysis_done_ = false;
+    ocr_done_ = false;
+    page_results_.reset();
+    skew_ = {};
+    rotation_ = 0;
+    orientation_.reset();
+    image_scale_ = 1.0f;
+  }
+
+  // SetMemoryBudget limits the memory used to load and process each image to
+  // roughly `bytes`, not counting the model. Larger images are scaled down
+  // when loaded. Zero means no limit.
+  void SetMemoryBudget(size_t bytes) { memory_budget_ = bytes; }
+
+  // SetTileSize enables tiled recognition of images larger than `size`
+  // pixels in either dimension. These are recognized in tiles of `size` x
+  // `size` pixels, which overlap by `overlap` pixels, so that memory use is
+  // bounded by the tile size rather than the page size. The overlap should be
+  // larger than any word. Zero or less selects `size / 8`. A `size` of zero
+  // disables tiling.
+  void SetTileSize(int size, int overlap) {
+    tile_size_ = std::max(size, 0);
+    if (overlap <= 0) {
+      overlap = tile_size_ / 8;
+    }
+    tile_overlap_ = std::min(overlap, tile_size_ / 2);
+  }
+
+  // GetImageScale returns the factor by which the current image was scaled
+  // down to fit the memory budget. Divide coordinates of results by this to
+  // get coordinates in the original image.
+  float GetImageScale() const { return image_scale_; }
+
+  // Recognize performs layout analysis and text recognition on the current
+  // image, if not already done.
+  void Recognize(const ProgressCallback& progress_callback = {}) {
+    DoOCR(progress_callback);
+  }
+
+  std::vector<TextRect> GetBoundingBoxes(TextUnit unit) {
+    if (UseTiles()) {
+      // Tiles are analysed and recognized together.
+      DoOCR({});
+    } else if (!layout_analysis_done_) {
+      tesseract_->AnalyseLayout();
+      layout_analysis_done_ = true;
+    }
+    return GetBoxes(unit, false /* with_text */);
+  }
+
+  std::vector<TextRect> GetTextBoxes(
+      TextUnit unit, const ProgressCallback& progress_callback = {}) {
+    DoOCR(progress_callback);
+    return GetBoxes(unit, true /* with_text */);
+  }
+
+  // Variants of GetBoundingBoxes and GetTextBoxes which return the results
+  // in one flat buffer, instead of an object and string per item.
+  std::unique_ptr<ByteView> GetBoundingBoxesPacked(TextUnit unit) {
+    if (UseTiles()) {
+      DoOCR({});
+    } else if (!layout_analysis_done_) {
+      tesseract_->AnalyseLayout();
+      layout_analysis_done_ = true;
+    }
+    return PackBoxes(unit, false /* with_text */);
+  }
+
+  std::unique_ptr<ByteView> GetTextBoxesPacked(
+      TextUnit unit, const ProgressCallback& progress_callback = {}) {
+    DoOCR(progress_callback);
+    return PackBoxes(unit, true /* with_text */);
+  }
+
+  std::string GetText(const ProgressCallback& progress_callback = {}) {
+    DoOCR(progress_callback);
+    if (page_results_) {
+      return page_results_->text;
+    }
+    return string_from_raw(tesseract_->GetUTF8Text());
+  }
+
+  std::string GetHOCR(const ProgressCallback& progress_callback = {}) {
+    DoOCR(progress_callback, true /* serial */);
+    return build_hocr(*tesseract_);
+  }
+
+  // GetResults recognizes the image if needed and returns any combination of
+  // the page text, word boxes, line boxes and hOCR, selected by `formats`.
+  // This is cheaper than calling `GetText`, `GetTextBoxes` and `GetHOCR`
+  // separately, as the text and boxes are produced in a single walk over the
+  // results.
+  //
+  // The outputs are returned in one buffer, laid out as described by
+  // `ocrlib_results_header` in capi.h.
+  std::unique_ptr<ByteView> GetResults(
+      ResultFormats formats, const ProgressCallback& progress_callback = {}) {
+    // hOCR can only be produced by recognizing the whole page on one thread.
+    // In that case produce the other formats from the same results.
+    DoOCR(progress_callback, formats & ResultHOCR /* serial */);
+
+    auto packer = CollectResults(formats);
+    auto results = std::make_unique<ByteView>(packer.Size());
+    if (!results->OOM()) {
+      packer.WriteTo(results->MutableBytes());
+    }
+    return results;
+  }
+
+  // CheckCanRecognize returns an error if parts of the current image can't
+  // be recognized, because there is no image or model loaded.
+  OCRResult CheckCanRecognize() const {
+    if (!tesseract_->GetInputImage()) {
+      return OCRResult("No image loaded");
+    }
+    if (!model_loaded_) {
+      return OCRResult("No text recognition model loaded");
+    }
+    return {};
+  }
+
+  // RecognizeRegions recognizes each of `regions` of the current image on its
+  // own, and returns the outputs selected by `formats` for each region, as
+  // for `GetResults`. This is much cheaper than recognizing the whole page
+  // when only a few parts of it are needed. Coordinates of results are
+  // relative to the page.
+  //
+  // Regions are clipped to the image. The results are returned in one
+  // buffer, laid out as described by `ocrlib_regions_header` in capi.h.
+  // Returns nullptr if `CheckCanRecognize` fails.
+  std::unique_ptr<ByteView> RecognizeRegions(
+      const std::vector<IntRect>& regions, ResultFormats formats,
+      const ProgressCallback& progress_callback = {}) {
+    if (!CheckCanRecognize().empty()) {
+      return nullptr;
+    }
+    ProgressMonitor monitor(progress_callback);
+    auto pix = tesseract_->GetInputImage();
+    int width = pixGetWidth(pix);
+    int height = pixGetHeight(pix);
+
+    // Set aside results for the whole page, which `CollectResults` would
+    // otherwise use. Results held by `tesseract_` are replaced by those for
+    // each region, so copy them first.
+    KeepPageResults();
+    auto page_results = std::move(page_results_);
+
+    std::vector<IntRect> clipped;
+    std::vector<ResultsPacker> results;
+    for (const auto& region : regions) {
+      IntRect rect = {
+          .left = std::clamp(region.left, 0, width),
+          .right = std::clamp(region.right, 0, width),
+          .top = std::clamp(region.top, 0, height),
+          .bottom = std::clamp(region.bottom, 0, height),
+      };
+      rect.right = std::max(rect.left, rect.right);
+      rect.bottom = std::max(rect.top, rect.bottom);
+      clipped.push_back(rect);
+
+      if (rect.right > rect.left && rect.bottom > rect.top) {
+        // Thresholding and recognition are limited to the rectangle.
+        tesseract_->SetRectangle(rect.left, rect.top, rect.right - rect.left,
+                                 rect.bottom - rect.top);
+        tesseract_->Recognize(nullptr);
+        results.push_back(CollectResults(formats));
+      } else {
+        results.emplace_back(formats);
+      }
+      monitor.ProgressChanged(results.size() * 100 / regions.size());
+    }
+    monitor.ProgressChanged(100);
+
+    tesseract_->SetRectangle(0, 0, width, height);
+    page_results_ = std::move(page_results);
+    layout_analysis_done_ = page_results_ != nullptr;
+
+    auto align = [](size_t offset) { return (offset + 3) & ~size_t(3); };
+    ocrlib_regions_header header = {
+        .count = uint32_t(regions.size()),
+        .record_size = sizeof(ocrlib_region_results),
+        .records_offset = sizeof(ocrlib_regions_header),
+    };
+    std::vector<ocrlib_region_results> records;
+    size_t offset =
+        header.records_offset + regions.size() * sizeof(ocrlib_region_results);
+    for (size_t i = 0; i < regions.size(); i++) {
+      offset = align(offset);
+      records.push_back({
+          .left = clipped[i].left,
+          .top = clipped[i].top,
+          .right = clipped[i].right,
+          .bottom = clipped[i].bottom,
+          .results_offset = uint32_t(offset),
+          .results_size = uint32_t(results[i].Size()),
+      });
+      offset += records.back().results_size;
+    }
+
+    auto packed = std::make_unique<ByteView>(offset);
+    if (packed->OOM()) {
+      return packed;
+    }
+    auto out = packed->MutableBytes();
+    memset(out, 0, offset);
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + header.records_offset, records.data(),
+           records.size() * sizeof(ocrlib_region_results));
+    for (size_t i = 0; i < regions.size(); i++) {
+      results[i].WriteTo(out + records[i].results_offset);
+    }
+    return packed;
+  }
+
+  // RecognizeBatch recognizes each of a batch of small images, such as text
+  // fields cropped from a form, and returns the outputs selected by `formats`
+  // for each, as for `GetResults`. Compared to loading and recognizing each
+  // image in turn, this saves a round trip per image and reuses the engine's
+  // setup across the batch. Images are recognized concurrently in builds with
+  // threads.
+  //
+  // `data` holds the images, laid out as described by `ocrlib_batch_header`
+  // in capi.h, and so does the returned buffer. `psm` is the page
+  // segmentation mode used for every image, or -1 to use the current mode.
+  // The current image and its results are kept. Returns nullptr if `data` or
+  // `psm` is invalid.
+  std::unique_ptr<ByteView> RecognizeBatch(
+      const ByteView& data, int psm, ResultFormats formats,
+      const ProgressCallback& progress_callback = {}) {
+    return RecognizeBatch(data.Bytes(), data.Size(), psm, formats,
+                          progress_callback);
+  }
+
+  std::unique_ptr<ByteView> RecognizeBatch(
+      const unsigned char* data, size_t size, int psm, ResultFormats formats,
+      const ProgressCallback& progress_callback = {}) {
+    if (psm < -1 || psm >= tesseract::PSM_COUNT) {
+      return nullptr;
+    }
+    ocrlib_batch_header input_header;
+    if (size < sizeof(input_header)) {
+      return nullptr;
+    }
+    memcpy(&input_header, data, sizeof(input_header));
+    if (input_header.record_size != sizeof(ocrlib_batch_image) ||
+        input_header.records_offset > size ||
+        (size - input_header.records_offset) / sizeof(ocrlib_batch_image) <
+            input_header.count) {
+      return nullptr;
+    }
+    std::vector<ocrlib_batch_image> images(input_header.count);
+    memcpy(images.data(), data + input_header.records_offset,
+           images.size() * sizeof(ocrlib_batch_image));
+    for (const auto& image : images) {
+      if (image.data_offset > size || size - image.data_offset < image.data_size) {
+        return nullptr;
+      }
+    }
+
+    ProgressMonitor monitor(progress_callback);
+    auto mode = psm < 0 ? tesseract_->GetPageSegMode()
+                        : tesseract::PageSegMode(psm);
+
+    // Images are recognized in chunks. The images of a chunk are copied into
+    // one sheet, which is set as the engine's image once, and each image is
+    // then recognized by setting the engine's rectangle to it. Thresholding
+    // and recognition are limited to the rectangle, so this gives the same
+    // results as recognizing each image on its own, without copying each
+    // image into the engine and setting up and tearing down its state for
+    // each. hOCR takes its coordinates from the engine's image, so when it is
+    // requested each image is set as the engine's image instead.
+    const size_t chunk_size = 64;
+    size_t chunk_count = (images.size() + chunk_size - 1) / chunk_size;
+    bool use_sheets = !(formats & ResultHOCR);
+
+    std::vector<int32_t> status(images.size(), 0);
+    std::vector<ResultsPacker> results(images.size(), ResultsPacker(formats));
+    auto recognize_chunk = [&](tesseract::TessBaseAPI& api, size_t chunk) {
+      size_t begin = chunk * chunk_size;
+      size_t end = std::min(images.size(), begin + chunk_size);
+
+      std::vector<PIX*> pixs(end - begin);
+      for (size_t i = begin; i < end; i++) {
+        const auto& image = images[i];
+        const unsigned char* bytes = data + image.data_offset;
+        PIX* pix = image.width == 0
+                       ? pixReadMem(bytes, image.data_size)
+                       : pix_from_raw_pixels(bytes, image.data_size,
+                                             image.width, image.height,
+                                             image.bytes_per_pixel,
+                                             image.stride);
+        if (pix && use_sheets) {
+          // Convert to the sheet's format, blending any alpha channel with
+          // white as `SetImage` does.
+          PIX* pix32 = pixGetSpp(pix) == 4 ? pixRemoveAlpha(pix)
+                                           : pixConvertTo32(pix);
+          if (pix32) {
+            pixCopyResolution(pix32, pix);
+          }
+          pixDestroy(&pix);
+          pix = pix32;
+        }
+        if (!pix) {
+          status[i] = 1;
+        }
+        pixs[i - begin] = pix;
+      }
+      api.SetPageSegMode(mode);
+
+      if (!use_sheets) {
+        for (size_t i = begin; i < end; i++) {
+          auto& pix = pixs[i - begin];
+          if (!pix) {
+            continue;
+          }
+          api.SetImage(&pix);
+          if (api.Recognize(nullptr) == 0) {
+            results[i] = collect_results(api, formats);
+          } else {
+            status[i] = 1;
+          }
+          api.Clear();
+        }
+        return;
+      }
+
+      // Lay the images out in rows, left to right.
+      const int gap = 2;
+      int sheet_width = 2048;
+      for (auto pix : pixs) {
+        if (pix) {
+          sheet_width = std::max(sheet_width, int(pixGetWidth(pix)));
+        }
+      }
+      std::vector<IntRect> rects(pixs.size());
+      int x = 0;
+      int y = 0;
+      int row_height = 0;
+      for (size_t i = 0; i < pixs.size(); i++) {
+        if (!pixs[i]) {
+          continue;
+        }
+        int width = pixGetWidth(pixs[i]);
+        int height = pixGetHeight(pixs[i]);
+        if (x > 0 && x + width > sheet_width) {
+          x = 0;
+          y += row_height + gap;
+          row_height = 0;
+        }
+        rects[i] = {.left = x, .right = x + width, .top = y,
+                    .bottom = y + height};
+        x += width + gap;
+        row_height = std::max(row_height, height);
+      }
+
+      PIX* sheet = y + row_height > 0
+                       ? pixCreate(sheet_width, y + row_height, 32)
+                       : nullptr;
+      bool has_sheet = sheet != nullptr;
+      if (has_sheet) {
+        pixSetAll(sheet);
+        for (size_t i = 0; i < pixs.size(); i++) {
+          if (pixs[i]) {
+            const auto& rect = rects[i];
+            pixRasterop(sheet, rect.left, rect.top, rect.right - rect.left,
+                        rect.bottom - rect.top, PIX_SRC, pixs[i], 0, 0);
+          }
+        }
+        // Takes ownership of the sheet.
+        api.SetImage(&sheet);
+      }
+
+      for (size_t i = begin; i < end; i++) {
+        auto& pix = pixs[i - begin];
+        if (!pix) {
+          continue;
+        }
+        if (!has_sheet) {
+          status[i] = 1;
+          pixDestroy(&pix);
+          continue;
+        }
+        const auto& rect = rects[i - begin];
+        api.SetRectangle(rect.left, rect.top, rect.right - rect.left,
+                         rect.bottom - rect.top);
+        // Use the image's own resolution, as setting it as the engine's
+        // image would.
+        api.SetSourceResolution(pixGetYRes(pix));
+        if (api.Recognize(nullptr) == 0) {
+          results[i] = collect_results(api, formats);
+          results[i].words.Translate(-rect.left, -rect.top);
+          results[i].lines.Translate(-rect.left, -rect.top);
+        } else {
+          status[i] = 1;
+        }
+        pixDestroy(&pix);
+      }
+      if (has_sheet) {
+        api.Clear();
+      }
+    };
+    auto report_progress = [&](size_t completed) {
+      monitor.ProgressChanged(completed * 100 / chunk_count);
+    };
+
+    // Chunks left to recognize using `tesseract_`, because there are no
+    // threads or the worker for a thread could not be created.
+    std::vector<uint8_t> serial(chunk_count, 1);
+    auto& pool = GetPool();
+    bool parallel = pool.Size() > 1 && HasWorkerModel() && chunk_count > 1;
+    if (parallel) {
+      pool.Run(
+          chunk_count,
+          [&](size_t index, size_t thread) {
+            if (auto worker = GetWorker(thread)) {
+              recognize_chunk(*worker, index);
+              serial[index] = 0;
+            }
+          },
+          report_progress);
+    }
+    if (std::find(serial.begin(), serial.end(), 1) != serial.end()) {
+      // Set the current image and its results aside while `tesseract_` is
+      // used for the batch, as `RecognizeRegions` does, and restore them
+      // afterwards.
+      KeepPageResults();
+      auto page_results = std::move(page_results_);
+      auto page = tesseract_->GetInputImage();
+      if (page) {
+        page = pixClone(page);
+      }
+      int resolution = tesseract_->GetSourceYResolution();
+      auto saved_mode = tesseract_->GetPageSegMode();
+
+      for (size_t i = 0; i < chunk_count; i++) {
+        if (serial[i]) {
+          recognize_chunk(*tesseract_, i);
+          if (!parallel) {
+            report_progress(i + 1);
+          }
+        }
+      }
+
+      tesseract_->SetPageSegMode(saved_mode);
+      if (page) {
+        tesseract_->SetImage(&page);
+        tesseract_->SetSourceResolution(resolution);
+      }
+      page_results_ = std::move(page_results);
+      layout_analysis_done_ = page_results_ != nullptr;
+    }
+    monitor.ProgressChanged(100);
+
+    auto align = [](size_t offset) { return (offset + 3) & ~size_t(3); };
+    ocrlib_batch_header header = {
+        .count = uint32_t(images.size()),
+        .record_size = sizeof(ocrlib_batch_result),
+        .records_offset = sizeof(ocrlib_batch_header),
+    };
+    std::vector<ocrlib_batch_result> records;
+    size_t offset =
+        header.records_offset + images.size() * sizeof(ocrlib_batch_result);
+    for (size_t i = 0; i < images.size(); i++) {
+      offset = align(offset);
+      records.push_back({
+          .status = status[i],
+          .results_offset = uint32_t(offset),
+          .results_size = uint32_t(results[i].Size()),
+      });
+      offset += records.back().results_size;
+    }
+
+    auto packed = std::make_unique<ByteView>(offset);
+    if (packed->OOM()) {
+      return packed;
+    }
+    auto out = packed->MutableBytes();
+    memset(out, 0, offset);
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + header.records_offset, records.data(),
+           records.size() * sizeof(ocrlib_batch_result));
+    for (size_t i = 0; i < images.size(); i++) {
+      results[i].WriteTo(out + records[i].results_offset);
+    }
+    return packed;
+  }
+
+  // RecognizeLines recognizes the text in each of `lines` of the current
+  // image. These are boxes around single lines of text that the caller has
+  // already found, eg. with a text detector, so page layout analysis is
+  // skipped and each box is recognized as a raw line of text. With threads,
+  // lines are recognized concurrently.
+  //
+  // Returns one item per box, in order, holding the box clipped to the
+  // image, the line's text and its mean confidence. Boxes that are empty
+  // after clipping give empty text. Returns no items if `CheckCanRecognize`
+  // fails.
+  std::vector<TextRect> RecognizeLines(
+      const std::vector<IntRect>& lines,
+      const ProgressCallback& progress_callback = {}) {
+    if (!CheckCanRecognize().empty()) {
+      return {};
+    }
+    ProgressMonitor monitor(progress_callback);
+    auto page = tesseract_->GetInputImage();
+    int width = pixGetWidth(page);
+    int height = pixGetHeight(page);
+
+    std::vector<TextRect> results(lines.size());
+    for (size_t i = 0; i < lines.size(); i++) {
+      auto& rect = results[i].rect;
+      rect = {
+          .left = std::clamp(lines[i].left, 0, width),
+          .right = std::clamp(lines[i].right, 0, width),
+          .top = std::clamp(lines[i].top, 0, height),
+          .bottom = std::clamp(lines[i].bottom, 0, height),
+      };
+      rect.right = std::max(rect.left, rect.right);
+      rect.bottom = std::max(rect.top, rect.bottom);
+      results[i].flags = StartOfLine | EndOfLine;
+    }
+    auto is_empty = [](const IntRect& rect) {
+      return rect.right == rect.left || rect.bottom == rect.top;
+    };
+
+    // Read the text of the line that `api` has been set up for. This
+    // recognizes the line.
+    auto read_line = [](tesseract::TessBaseAPI& api, TextRect& line) {
+      auto text = api.GetUTF8Text();
+      if (!text) {
+        return;
+      }
+      line.text = string_from_raw(text);
+      while (!line.text.empty() && line.text.back() == '\n') {
+        line.text.pop_back();
+      }
+      line.confidence = api.MeanTextConf() / 100.0f;
+    };
+    auto report_progress = [&](size_t completed) {
+      monitor.ProgressChanged(completed * 100 / lines.size());
+    };
+
+    // Lines left to recognize using `tesseract_`, because there are no
+    // threads or the worker for a thread could not be created.
+    std::vector<uint8_t> serial(lines.size(), 1);
+    auto& pool = GetPool();
+    bool parallel = pool.Size() > 1 && HasWorkerModel() && lines.size() > 1;
+    if (parallel) {
+      int resolution = tesseract_->GetSourceYResolution();
+      pool.Run(
+          lines.size(),
+          [&](size_t index, size_t thread) {
+            auto& line = results[index];
+            auto worker = GetWorker(thread);
+            if (!worker) {
+              return;
+            }
+            serial[index] = 0;
+            if (is_empty(line.rect)) {
+              return;
+            }
+            auto box = boxCreate(line.rect.left, line.rect.top,
+                                 line.rect.right - line.rect.left,
+                                 line.rect.bottom - line.rect.top);
+            auto pix = pixClipRectangle(page, box, nullptr);
+            boxDestroy(&box);
+            if (!pix) {
+              return;
+            }
+            worker->SetPageSegMode(tesseract::PSM_RAW_LINE);
+            worker->SetImage(&pix);
+            worker->SetSourceResolution(resolution);
+            read_line(*worker, line);
+            worker->Clear();
+          },
+          report_progress);
+    }
+    if (std::find(serial.begin(), serial.end(), 1) != serial.end()) {
+      // As in `RecognizeRegions`, results held by `tesseract_` are replaced
+      // by those for each line, so keep any for the whole page.
+      KeepPageResults();
+      auto page_results = std::move(page_results_);
+      auto psm = tesseract_->GetPageSegMode();
+      tesseract_->SetPageSegMode(tesseract::PSM_RAW_LINE);
+      for (size_t i = 0; i < lines.size(); i++) {
+        auto& line = results[i];
+        if (serial[i] && !is_empty(line.rect)) {
+          tesseract_->SetRectangle(line.rect.left, line.rect.top,
+                                   line.rect.right - line.rect.left,
+                                   line.rect.bottom - line.rect.top);
+          read_line(*tesseract_, line);
+        }
+        if (!parallel) {
+          report_progress(i + 1);
+        }
+      }
+      tesseract_->SetPageSegMode(psm);
+      tesseract_->SetRectangle(0, 0, width, height);
+      page_results_ = std::move(page_results);
+      layout_analysis_done_ = page_results_ != nullptr;
+    }
+    monitor.ProgressChanged(100);
+    return results;
+  }
+
+  // Variant of RecognizeLines which returns the results in one flat buffer,
+  // as for `GetTextBoxesPacked`, or nullptr if `CheckCanRecognize` fails.
+  std::unique_ptr<ByteView> RecognizeLinesPacked(
+      const std::vector<IntRect>& lines,
+      const ProgressCallback& progress_callback = {}) {
+    if (!CheckCanRecognize().empty()) {
+      return nullptr;
+    }
+    BoxPacker packer;
+    for (const auto& line : RecognizeLines(lines, progress_callback)) {
+      packer.Add(line, line.text.c_str());
+    }
+    auto packed = std::make_unique<ByteView>(packer.Size());
+    if (!packed->OOM()) {
+      packer.WriteTo(packed->MutableBytes());
+    }
+    return packed;
+  }
+
+  // GetSkew returns the skew that the deskew preprocessing step measured when
+  // the current image was loaded, or zero if it was not deskewed.
+  Skew GetSkew() const { return skew_; }
+
+  // GetAppliedRotation returns the clockwise rotation, in degrees, that the
+  // `auto_orient` load option detected in the current image and corrected,
+  // or 0 if none was.
+  int GetAppliedRotation() const { return rotation_; }
+
+  // GetOrientation estimates the orientation of the current image. The result
+  // is cached until another image is loaded.
+  Orientation GetOrientation() {
+    if (!orientation_) {
+      orientation_ = DetectOrientation();
+    }
+    return *orientation_;
+  }
+
+ private:
+  Orientation DetectOrientation() {
+    // Tesseract's orientation detection is part of the legacy (non-LSTM)
+    // engine, which is not compiled in to reduce binary size. Hence we use
+    // Leptonica's orientation detection instead. See comments for
+    // `pixOrientDetect` in the Leptonica source for details of how it works.
+    //
+    // The method is simplistic, and is designed for latin text, but it serves
+    // as a baseline that can be improved upon later.
+    //
+    // This returns a clone of the image that Tesseract thresholds once per
+    // page, and reuses for layout analysis.
+    auto pix = tesseract_->GetThresholdedImage();
+    if (!pix) {
+      return {};
+    }
+
+    // Large scans are reduced 2x or 4x first, leaving at least 1000px on the
+    // shorter side, which is plenty to tell ascenders from descenders. Rank 1
+    // reduction (any ON pixel sets the output pixel) keeps thin strokes.
+    int min_size = std::min(pixGetWidth(pix), pixGetHeight(pix));
+    if (min_size >= 2000) {
+      auto pixr = pixReduceRankBinaryCascade(pix, 1, min_size >= 4000 ? 1 : 0,
+                                             0, 0);
+      if (pixr) {
+        pixDestroy(&pix);
+        pix = pixr;
+      }
+    }
 
     // Metric that indicates whether the image is right-side up vs upside down.
     // +ve indicates right-side up.
@@ -324,47 +2117,241 @@ class OCREngine {
     return {.rotation = rotation, .confidence = 1};
   }
 
- private:
+
   std::vector<TextRect> GetBoxes(TextUnit unit, bool with_text) {
+    std::vector<TextRect> boxes;
+    VisitBoxes(unit, with_text, [&](TextRect& tr, const char* text) {
+      tr.text = text;
+      boxes.push_back(std::move(tr));
+    });
+    return boxes;
+  }
+
+  // PackBoxes serializes the boxes for `unit` into a single buffer, laid out
+  // as described by `ocrlib_packed_boxes_header` in capi.h.
+  std::unique_ptr<ByteView> PackBoxes(TextUnit unit, bool with_text) {
+    BoxPacker packer;
+    VisitBoxes(unit, with_text, [&](const TextRect& tr, const char* text) {
+      packer.Add(tr, text);
+    });
+
+    auto packed = std::make_unique<ByteView>(packer.Size());
+    if (!packed->OOM()) {
+      packer.WriteTo(packed->MutableBytes());
+    }
+    return packed;
+  }
+
+  // VisitBoxes walks the results at the level for `unit` and calls
+  // `visit(TextRect&, const char* text)` for each item. The `text` field of
+  // the TextRect is left empty and the item's text is passed separately, so
+  // that callers can avoid a string allocation per item. `text` is empty if
+  // `with_text` is false.
+  template <class Visitor>
+  void VisitBoxes(TextUnit unit, bool with_text, Visitor&& visit) {
+    if (page_results_) {
+      auto& items =
+          unit == TextUnit::Word ? page_results_->words : page_results_->lines;
+      for (auto tr : items) {
+        auto text = std::move(tr.text);
+        if (!with_text) {
+          tr.confidence = 0;
+          text.clear();
+        }
+        visit(tr, text.c_str());
+      }
+      return;
+    }
+
     auto iter = unique_from_raw(tesseract_->GetIterator());
     if (!iter) {
-      return {};
+      return;
     }
 
     auto level = iterator_level_from_unit(unit);
-    std::vector<TextRect> boxes;
     do {
       TextRect tr;
-      if (with_text) {
-        // Tesseract provides confidence as a percentage. Convert it to a score
-        // in [0, 1]
-        tr.confidence = iter->Confidence(level) * 0.01;
-        tr.text = string_from_raw(iter->GetUTF8Text(level));
+      auto text = read_text_rect(*iter, unit, with_text, tr);
+      visit(tr, text ? text.get() : "");
+    } while (iter->Next(level));
+  }
+
+  // CollectResults gathers the outputs selected by `formats` from the
+  // current results.
+  ResultsPacker CollectResults(ResultFormats formats) {
+    ResultsPacker packer(formats);
+    if (formats & (ResultText | ResultWordBoxes | ResultLineBoxes)) {
+      WalkResults(formats & ResultText ? &packer.text : nullptr,
+                  formats & ResultWordBoxes ? &packer.words : nullptr,
+                  formats & ResultLineBoxes ? &packer.lines : nullptr);
+    }
+    if (formats & ResultHOCR) {
+      packer.hocr = build_hocr(*tesseract_);
+    }
+    return packer;
+  }
+
+  // WalkResults produces any of the page text, word boxes and line boxes in a
+  // single walk over the results. Outputs which are null are skipped.
+  void WalkResults(std::string* text, BoxPacker* words, BoxPacker* lines) {
+    if (page_results_) {
+      if (text) {
+        *text = page_results_->text;
+      }
+      if (words) {
+        for (const auto& tr : page_results_->words) {
+          words->Add(tr, tr.text.c_str());
+        }
+      }
+      if (lines) {
+        for (const auto& tr : page_results_->lines) {
+          lines->Add(tr, tr.text.c_str());
+        }
+      }
+      return;
+    }
+
+    walk_api_results(*tesseract_, text, words, lines);
+  }
+
+  // KeepPageResults copies the results of recognizing the whole page that
+  // `tesseract_` holds, if any, into `page_results_`, so that they survive
+  // using `tesseract_` to recognize part of the page. The text and boxes are
+  // then available without recognizing the page again, but hOCR, which is
+  // built from `tesseract_`, is not.
+  void KeepPageResults() {
+    if (ocr_done_ && !page_results_) {
+      auto page = std::make_unique<PageResults>();
+      auto add_item = [](std::vector<TextRect>& items) {
+        return [&items](TextRect& tr, const char* text) {
+          tr.text = text;
+          items.push_back(std::move(tr));
+        };
+      };
+      auto iter = unique_from_raw(tesseract_->GetIterator());
+      if (iter) {
+        walk_results(*iter, &page->text, add_item(page->words),
+                     add_item(page->lines));
       }
+      page_results_ = std::move(page);
+    }
+    // The caller is about to replace the results held by `tesseract_`.
+    ocr_done_ = false;
+  }
 
-      if (unit < TextUnit::Line) {
-        if (iter->IsAtBeginningOf(tesseract::RIL_TEXTLINE)) {
-          tr.flags |= LayoutFlag::StartOfLine;
+  // LoadPix preprocesses a decoded image and hands it to Tesseract, taking
+  // ownership of `pix`. `decode_scale` is the scale at which the image was
+  // decoded, relative to its original size.
+  OCRResult LoadPix(PIX* pix, const LoadImageOptions& options,
+                    float decode_scale = 1.0f) {
+    skew_ = {};
+    rotation_ = 0;
+    orientation_.reset();
+
+    float scale = scale_for_budget(
+        memory_budget_, estimate_page_memory(pixGetWidth(pix),
+                                             pixGetHeight(pix),
+                                             pixGetDepth(pix)));
+    if (scale < 1.0f) {
+      auto pixd = pixScale(pix, scale, scale);
+      pixDestroy(&pix);
+      pix = pixd;
+      if (!pix) {
+        return OCRResult("Failed to scale image to fit memory budget");
+      }
+    }
+    image_scale_ = decode_scale * scale;
+
+    if (options.auto_orient) {
+      int rotation = detect_rotation(pix);
+      if (rotation == 180) {
+        pixRotate180(pix, pix);
+      } else if (rotation != 0) {
+        // Quarter turns can't be done in place, as they change the shape of
+        // the image.
+        auto pixd = pixRotateOrth(pix, (360 - rotation) / 90);
+        pixDestroy(&pix);
+        pix = pixd;
+        if (!pix) {
+          return OCRResult("Failed to rotate image");
         }
-        if (iter->IsAtFinalElement(tesseract::RIL_TEXTLINE, level)) {
-          tr.flags |= LayoutFlag::EndOfLine;
+      }
+      rotation_ = rotation;
+    }
+
+    if (!options.preprocess.empty()) {
+      // Preprocessing steps expect 1, 8 or 32bpp images without colormaps.
+      if (pixGetColormap(pix)) {
+        auto pixd = pixRemoveColormap(pix, REMOVE_CMAP_BASED_ON_SRC);
+        pixDestroy(&pix);
+        pix = pixd;
+      }
+      if (pix && pixGetDepth(pix) != 1 && pixGetDepth(pix) < 8) {
+        auto pixd = pixConvertTo8(pix, 0);
+        pixDestroy(&pix);
+        pix = pixd;
+      }
+      // Each step frees its input once the output is made, so at most two
+      // copies of the page are alive at once.
+      for (const auto& step : options.preprocess) {
+        if (!pix) {
+          break;
         }
+        pix = apply_preprocess_step(pix, step, skew_);
+      }
+      if (!pix) {
+        return OCRResult("Failed to preprocess image");
       }
+    }
 
-      iter->BoundingBox(level, &tr.rect.left, &tr.rect.top, &tr.rect.right,
-                        &tr.rect.bottom);
-      boxes.push_back(tr);
-    } while (iter->Next(level));
+    auto underlines = options.underlines;
+    if (underlines == UnderlineMode::Remove ||
+        (underlines == UnderlineMode::Auto && has_underlines(pix))) {
+      pix = RemoveUnderlines(pix);
+      if (!pix) {
+        return OCRResult("Failed to remove underlines");
+      }
+    } else if (auto pixb = binary_from_two_level(pix)) {
+      pixDestroy(&pix);
+      pix = pixb;
+    }
 
-    return boxes;
+    // Initialize for layout analysis only if a model has not been loaded.
+    // This is a no-op if a model has been loaded.
+    tesseract_->InitForAnalysePage();
+    // Hand the Pix over to Tesseract instead of letting it take a copy, so we
+    // never hold two full-resolution copies of the page. This SetImage
+    // overload comes from patches/tesseract.diff and sets `pix` to nullptr.
+    tesseract_->SetImage(&pix);
+
+    layout_analysis_done_ = false;
+    ocr_done_ = false;
+    page_results_.reset();
+    return {};
   }
 
-  void DoOCR(const emscripten::val& progress_callback) {
+  // DoOCR recognizes the current image if not already done.
+  //
+  // If possible the page is recognized in tiles or in parallel, in which case
+  // the results are stored in `page_results_`. If `serial` is true, or the
+  // page cannot be recognized in parallel, the whole page is recognized by
+  // `tesseract_`. Pages that are large enough to use tiles are not recognized
+  // whole unless `serial` is true.
+  void DoOCR(const ProgressCallback& progress_callback, bool serial = false) {
     ProgressMonitor monitor(progress_callback);
-    if (!ocr_done_) {
-      tesseract_->Recognize(&monitor);
+    if (!ocr_done_ && (serial || !page_results_)) {
+      if (!serial && UseTiles()) {
+        page_results_ = RecognizeTiled(monitor);
+      } else {
+        if (!serial && CanRecognizeInParallel()) {
+          page_results_ = RecognizeParallel(monitor);
+        }
+        if (serial || !page_results_) {
+          tesseract_->Recognize(&monitor);
+          ocr_done_ = true;
+        }
+      }
       layout_analysis_done_ = true;
-      ocr_done_ = true;
     }
     // Tesseract doesn't seem to report 100% progress in `Recognize`, and
     // won't have reported progress if OCR has already been done, so report
@@ -372,11 +2359,926 @@ class OCREngine {
     monitor.ProgressChanged(100);
   }
 
+  // Return true if the current page is large enough to be recognized in
+  // tiles. See `SetTileSize`.
+  bool UseTiles() {
+    if (tile_size_ <= 0) {
+      return false;
+    }
+    auto pix = tesseract_->GetInputImage();
+    return pix &&
+           (pixGetWidth(pix) > tile_size_ || pixGetHeight(pix) > tile_size_);
+  }
+
+  // RecognizeTiled splits the page into overlapping tiles, recognizes each
+  // on its own and merges the results. With threads and a model that workers
+  // can load, tiles are recognized concurrently. Otherwise they are
+  // recognized one by one using `tesseract_`, which gets the page back
+  // afterwards.
+  //
+  // Tiles that fail to be recognized concurrently, eg. because a worker could
+  // not be created, are retried using `tesseract_`. The page is never
+  // recognized whole, as that needs the memory that tiling avoids, so a tile
+  // that fails again contributes no results, as a page that fails to be
+  // recognized would.
+  std::unique_ptr<PageResults> RecognizeTiled(ProgressMonitor& monitor) {
+    // Keep a reference to the page, as `tesseract_` may be used for tiles.
+    auto page = pixClone(tesseract_->GetInputImage());
+    int width = pixGetWidth(page);
+    int height = pixGetHeight(page);
+    int resolution = tesseract_->GetSourceYResolution();
+    auto psm = tesseract_->GetPageSegMode();
+
+    int step = tile_size_ - tile_overlap_;
+    int nx = 1 + std::max(0, (width - tile_size_ + step - 1) / step);
+    int ny = 1 + std::max(0, (height - tile_size_ + step - 1) / step);
+    std::vector<TileResults> tiles(nx * ny);
+
+    auto recognize_tile = [&](tesseract::TessBaseAPI& api, size_t index) {
+      auto& tile = tiles[index];
+      tile.failed = false;
+      tile.row = index / nx;
+      tile.col = index % nx;
+      int left = tile.col * step;
+      int top = tile.row * step;
+      int right = std::min(width, left + tile_size_);
+      int bottom = std::min(height, top + tile_size_);
+
+      // Tiles meet in the middle of their overlap.
+      int half_overlap = tile_overlap_ / 2;
+      tile.core = {
+          .left = tile.col == 0 ? 0 : left + half_overlap,
+          .right = tile.col + 1 == nx ? width : left + step + half_overlap,
+          .top = tile.row == 0 ? 0 : top + half_overlap,
+          .bottom = tile.row + 1 == ny ? height : top + step + half_overlap,
+      };
+
+      auto box = boxCreate(left, top, right - left, bottom - top);
+      auto pix = pixClipRectangle(page, box, nullptr);
+      boxDestroy(&box);
+      if (!pix) {
+        tile.failed = true;
+        return;
+      }
+      api.SetPageSegMode(psm);
+      api.SetImage(&pix);
+      api.SetSourceResolution(resolution);
+      if (api.Recognize(nullptr) != 0) {
+        tile.failed = true;
+      } else if (auto iter = unique_from_raw(api.GetIterator())) {
+        read_tile_words(*iter, left, top, tile);
+      }
+      api.Clear();
+    };
+    auto report_progress = [&](size_t completed) {
+      monitor.ProgressChanged(completed * 100 / tiles.size());
+    };
+
+    auto& pool = GetPool();
+    if (pool.Size() > 1 && HasWorkerModel()) {
+      pool.Run(
+          tiles.size(),
+          [&](size_t index, size_t thread) {
+            auto worker = GetWorker(thread);
+            if (!worker) {
+              tiles[index].failed = true;
+              return;
+            }
+            recognize_tile(*worker, index);
+          },
+          report_progress);
+
+      bool retried = false;
+      for (size_t i = 0; i < tiles.size(); i++) {
+        if (tiles[i].failed) {
+          recognize_tile(*tesseract_, i);
+          retried = true;
+        }
+      }
+      if (retried) {
+        tesseract_->SetImage(&page);
+        tesseract_->SetSourceResolution(resolution);
+      }
+    } else {
+      for (size_t i = 0; i < tiles.size(); i++) {
+        recognize_tile(*tesseract_, i);
+        report_progress(i + 1);
+      }
+      tesseract_->SetImage(&page);
+      tesseract_->SetSourceResolution(resolution);
+    }
+    pixDestroy(&page);
+
+    return merge_tile_results(tiles);
+  }
+
+  // Return true if the current page can be split into regions that are
+  // recognized in parallel.
+  bool CanRecognizeInParallel() const {
+    if (ThreadPool::DefaultSize() < 2 || !HasWorkerModel()) {
+      return false;
+    }
+    // Regions are recognized as blocks of text, which only gives the same
+    // results as recognizing the whole page when the page is treated as one
+    // or more blocks.
+    switch (tesseract_->GetPageSegMode()) {
+      case tesseract::PSM_AUTO:
+      case tesseract::PSM_AUTO_ONLY:
+      case tesseract::PSM_SINGLE_COLUMN:
+      case tesseract::PSM_SINGLE_BLOCK_VERT_TEXT:
+      case tesseract::PSM_SINGLE_BLOCK:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // RecognizeParallel performs layout analysis on the whole page, then splits
+  // it into regions which are recognized concurrently by a pool of threads,
+  // each with its own TessBaseAPI. The results are merged in reading order.
+  //
+  // Returns nullptr if the page could not be recognized this way.
+  std::unique_ptr<PageResults> RecognizeParallel(ProgressMonitor& monitor) {
+    auto& pool = GetPool();
+    if (!layout_analysis_done_) {
+      // The returned iterator is not needed, as `SplitPage` uses
+      // `GetIterator`.
+      unique_from_raw(tesseract_->AnalyseLayout());
+      layout_analysis_done_ = true;
+    }
+
+    // Use more regions than threads, as regions vary in size.
+    auto regions = SplitPage(pool.Size() * 2);
+    std::vector<PageResults> region_results(regions.size());
+    int resolution = tesseract_->GetSourceYResolution();
+    std::atomic<bool> failed = false;
+
+    pool.Run(
+        regions.size(),
+        [&](size_t index, size_t thread) {
+          auto& region = regions[index];
+          auto worker = GetWorker(thread);
+          if (!worker) {
+            pixDestroy(&region.pix);
+            failed = true;
+            return;
+          }
+          worker->SetPageSegMode(region.psm);
+          worker->SetImage(&region.pix);
+          worker->SetSourceResolution(resolution);
+          if (worker->Recognize(nullptr) != 0) {
+            failed = true;
+          }
+
+          auto& results = region_results[index];
+          auto add_item = [&](std::vector<TextRect>& items) {
+            return [&](TextRect& tr, const char* text) {
+              tr.rect.left += region.left;
+              tr.rect.right += region.left;
+              tr.rect.top += region.top;
+              tr.rect.bottom += region.top;
+              tr.text = text;
+              items.push_back(std::move(tr));
+            };
+          };
+          auto iter = unique_from_raw(worker->GetIterator());
+          if (iter) {
+            walk_results(*iter, &results.text, add_item(results.words),
+                         add_item(results.lines));
+          }
+          worker->Clear();
+        },
+        [&](size_t completed) {
+          monitor.ProgressChanged(completed * 100 / regions.size());
+        });
+
+    if (failed) {
+      return nullptr;
+    }
+
+    auto page = std::make_unique<PageResults>();
+    for (size_t i = 0; i < regions.size(); i++) {
+      auto& results = region_results[i];
+      // Tesseract ends each paragraph with a blank line. Regions which do not
+      // end a block usually end in the middle of a paragraph, so drop it.
+      if (!regions[i].ends_block && results.text.ends_with("\n\n")) {
+        results.text.pop_back();
+      }
+      page->text += results.text;
+      std::move(results.words.begin(), results.words.end(),
+                std::back_inserter(page->words));
+      std::move(results.lines.begin(), results.lines.end(),
+                std::back_inserter(page->lines));
+    }
+    return page;
+  }
+
+  // SplitPage splits the text blocks found by layout analysis into about
+  // `target_count` regions, in reading order. Blocks are split between
+  // lines, into bands with similar numbers of lines.
+  std::vector<PageRegion> SplitPage(size_t target_count) {
+    struct Line {
+      int top;
+      int bottom;
+    };
+    struct Block {
+      PIX* pix = nullptr;
+      int left = 0;
+      int top = 0;
+      tesseract::PolyBlockType type = tesseract::PT_UNKNOWN;
+      std::vector<Line> lines;
+    };
+
+    std::vector<Block> blocks;
+    size_t line_count = 0;
+    auto iter = unique_from_raw(tesseract_->GetIterator());
+    if (iter) {
+      do {
+        if (iter->IsAtBeginningOf(tesseract::RIL_BLOCK)) {
+          Block block = {.type = iter->BlockType()};
+          int right, bottom;
+          iter->BoundingBox(tesseract::RIL_BLOCK, &block.left, &block.top,
+                            &right, &bottom);
+          if (tesseract::PTIsTextType(block.type)) {
+            block.pix = iter->GetBinaryImage(tesseract::RIL_BLOCK);
+          }
+          blocks.push_back(std::move(block));
+        }
+        if (blocks.empty() || !blocks.back().pix ||
+            iter->Empty(tesseract::RIL_TEXTLINE)) {
+          continue;
+        }
+        Line line;
+        int left, right;
+        iter->BoundingBox(tesseract::RIL_TEXTLINE, &left, &line.top, &right,
+                          &line.bottom);
+        blocks.back().lines.push_back(line);
+        line_count++;
+      } while (iter->Next(tesseract::RIL_TEXTLINE));
+    }
+
+    std::vector<PageRegion> regions;
+    for (auto& block : blocks) {
+      if (!block.pix) {
+        continue;
+      }
+      if (block.lines.empty()) {
+        pixDestroy(&block.pix);
+        continue;
+      }
+
+      auto psm = block.type == tesseract::PT_VERTICAL_TEXT
+                     ? tesseract::PSM_SINGLE_BLOCK_VERT_TEXT
+                     : tesseract::PSM_SINGLE_BLOCK;
+      size_t band_count = 1;
+      if (psm == tesseract::PSM_SINGLE_BLOCK) {
+        band_count = std::clamp(
+            (block.lines.size() * target_count + line_count - 1) / line_count,
+            size_t(1), block.lines.size());
+      }
+
+      // Find the y coordinates, relative to the block, where each band
+      // starts. Cuts are placed halfway between adjacent lines, and only
+      // where the next line is below the previous one.
+      std::vector<int> band_tops = {0};
+      for (size_t band = 1; band < band_count; band++) {
+        const auto& prev = block.lines[band * block.lines.size() / band_count - 1];
+        const auto& next = block.lines[band * block.lines.size() / band_count];
+        int cut = (prev.bottom + next.top) / 2 - block.top;
+        if (next.top > prev.top && cut > band_tops.back()) {
+          band_tops.push_back(cut);
+        }
+      }
+
+      if (band_tops.size() == 1) {
+        regions.push_back({.pix = block.pix,
+                           .left = block.left,
+                           .top = block.top,
+                           .psm = psm});
+        continue;
+      }
+
+      int width = pixGetWidth(block.pix);
+      int height = pixGetHeight(block.pix);
+      for (size_t band = 0; band < band_tops.size(); band++) {
+        int top = band_tops[band];
+        int bottom = band + 1 < band_tops.size() ? band_tops[band + 1] : height;
+        auto box = boxCreate(0, top, width, bottom - top);
+        regions.push_back({.pix = pixClipRectangle(block.pix, box, nullptr),
+                           .left = block.left,
+                           .top = block.top + top,
+                           .psm = psm,
+                           .ends_block = band + 1 == band_tops.size()});
+        boxDestroy(&box);
+      }
+      pixDestroy(&block.pix);
+    }
+    return regions;
+  }
+
+  // GetPool returns the thread pool, creating it if needed. It has one thread
+  // per core, up to `OCRLIB_MAX_THREADS`, in builds with threads.
+  //
+  // The pool is shared by all engines, so that the number of threads never
+  // exceeds the Web Workers that the Emscripten runtime starts when the module
+  // is loaded (`-sPTHREAD_POOL_SIZE`). A thread that needs a new worker can't
+  // start until the creating thread returns to the event loop, which `Run`
+  // never does. Engines used on different threads take turns to `Run` tasks
+  // on the pool.
+  static ThreadPool& GetPool() {
+    static ThreadPool pool(ThreadPool::DefaultSize());
+    return pool;
+  }
+
+  // Return true if the pool threads have a model to recognize text with.
+  bool HasWorkerModel() const { return !model_data_.empty(); }
+
+  // CreateWorker returns a TessBaseAPI for a pool thread, with the current
+  // model and variables. Returns nullptr if the model fails to load.
+  std::unique_ptr<tesseract::TessBaseAPI> CreateWorker() {
+    auto api = std::make_unique<tesseract::TessBaseAPI>();
+    if (!init_tesseract(*api, model_data_.data(), model_data_.size(),
+                        model_lang_)) {
+      return nullptr;
+    }
+    for (const auto& [name, value] : variables_) {
+      api->SetVariable(name.c_str(), value.c_str());
+    }
+    return api;
+  }
+
+  // GetWorker returns the TessBaseAPI used by thread `thread` of the pool,
+  // creating it if needed. Returns nullptr if there is no model or it fails
+  // to load, in which case callers recognize the work using `tesseract_`
+  // instead.
+  tesseract::TessBaseAPI* GetWorker(size_t thread) {
+    if (!HasWorkerModel()) {
+      return nullptr;
+    }
+    auto& worker = workers_[thread];
+    if (!worker) {
+      worker = CreateWorker();
+    }
+    return worker.get();
+  }
+
+  bool model_loaded_ = false;
   bool layout_analysis_done_ = false;
   bool ocr_done_ = false;
   std::unique_ptr<tesseract::TessBaseAPI> tesseract_;
+
+  // Skew measured when preprocessing the current image.
+  Skew skew_;
+  // Rotation corrected when loading the current image.
+  int rotation_ = 0;
+  // Cached result of `GetOrientation` for the current image.
+  std::optional<Orientation> orientation_;
+
+  size_t memory_budget_ = 0;
+  // Tiling settings. See `SetTileSize`.
+  int tile_size_ = 0;
+  int tile_overlap_ = 0;
+  // Scale of the current image relative to the original, due to the budget.
+  float image_scale_ = 1.0f;
+
+  // Results of `RecognizeParallel` for the current image, if used.
+  std::unique_ptr<PageResults> page_results_;
+
+  // State for recognizing pages in parallel, only used in builds with
+  // threads. `workers_` has one entry per pool thread, created by
+  // `GetWorker` from the copy of the model that `LoadModel` keeps.
+  std::vector<unsigned char> model_data_;
+  std::string model_lang_;
+  std::map<std::string, std::string> variables_;
+  std::vector<std::unique_ptr<tesseract::TessBaseAPI>> workers_;
+};
+
+// Implementation of the C API declared in capi.h.
+
+struct ocrlib_engine {
+  OCREngine engine;
+  std::string last_error;
+  bool model_loaded = false;
+  bool image_loaded = false;
+
+  // Results kept by `ocrlib_engine_get_results` and the other functions
+  // which return a results buffer when the caller's buffer was too small,
+  // and the call that produced them.
+  struct ResultsKey {
+    enum class Source { Page, Regions, Lines, Batch };
+    Source source = Source::Page;
+    int32_t formats = 0;
+    int32_t psm = 0;
+    std::vector<IntRect> rects;
+    // Input of `ocrlib_engine_recognize_batch`. Callers must pass the same,
+    // unchanged buffer to get kept results, so it is not copied.
+    const uint8_t* batch = nullptr;
+    size_t batch_size = 0;
+
+    bool operator==(const ResultsKey&) const = default;
+  };
+  std::unique_ptr<ByteView> results;
+  ResultsKey results_key;
+};
+
+namespace {
+
+size_t copy_to_buffer(const std::string& str, char* buf, size_t capacity) {
+  if (capacity > 0) {
+    auto len = std::min(str.size(), capacity - 1);
+    memcpy(buf, str.data(), len);
+    buf[len] = '\0';
+  }
+  return str.size();
+}
+
+int32_t set_result(ocrlib_engine* engine, const OCRResult& error) {
+  if (!error.empty()) {
+    engine->last_error = error;
+    return -1;
+  }
+  return 0;
+}
+
+// Copy the results kept in `engine` into `buf` if they fit, and release
+// them. Returns the size of the results.
+int32_t copy_results(ocrlib_engine* engine, uint8_t* buf, size_t capacity) {
+  if (engine->results->OOM()) {
+    engine->results.reset();
+    engine->last_error = "Failed to allocate results buffer";
+    return -1;
+  }
+
+  size_t size = engine->results->Size();
+  if (size <= capacity) {
+    memcpy(buf, engine->results->Bytes(), size);
+    engine->results.reset();
+  }
+  return size;
+}
+
+// Convert rectangles of the C API.
+std::vector<IntRect> rects_from_c(const ocrlib_rect* rects, size_t count) {
+  std::vector<IntRect> result;
+  for (size_t i = 0; i < count; i++) {
+    result.push_back({.left = rects[i].left,
+                      .right = rects[i].right,
+                      .top = rects[i].top,
+                      .bottom = rects[i].bottom});
+  }
+  return result;
+}
+
+bool check_image_loaded(ocrlib_engine* engine) {
+  if (!engine->image_loaded) {
+    engine->last_error = "No image loaded";
+  }
+  return engine->image_loaded;
+}
+
+// Convert the preprocessing steps of the C API. Returns false if a step is
+// invalid.
+bool preprocess_steps_from_c(const ocrlib_preprocess_step* steps, size_t count,
+                             std::vector<PreprocessStep>& out) {
+  for (size_t i = 0; i < count; i++) {
+    if (steps[i].op < OCRLIB_PREPROCESS_DESKEW ||
+        steps[i].op > OCRLIB_PREPROCESS_REMOVE_BORDER) {
+      return false;
+    }
+    out.push_back({.op = static_cast<PreprocessOp>(steps[i].op),
+                   .value = steps[i].value});
+  }
+  return true;
+}
+
+// Convert the `remove_underlines` argument of the C API. Unknown non-zero
+// values mean "remove", as the argument used to be a boolean.
+UnderlineMode underline_mode_from_int(int32_t mode) {
+  switch (mode) {
+    case OCRLIB_UNDERLINES_KEEP:
+      return UnderlineMode::Keep;
+    case OCRLIB_UNDERLINES_AUTO:
+      return UnderlineMode::Auto;
+    default:
+      return UnderlineMode::Remove;
+  }
+}
+
+bool check_model_loaded(ocrlib_engine* engine) {
+  if (!engine->model_loaded) {
+    engine->last_error = "No text recognition model loaded";
+  }
+  return engine->model_loaded;
+}
+
+}  // namespace
+
+extern "C" {
+
+EMSCRIPTEN_KEEPALIVE
+size_t ocrlib_version(char* buf, size_t capacity) {
+  return copy_to_buffer(tesseract::TessBaseAPI::Version(), buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+ocrlib_engine* ocrlib_engine_create() { return new ocrlib_engine(); }
+
+EMSCRIPTEN_KEEPALIVE
+void ocrlib_engine_destroy(ocrlib_engine* engine) { delete engine; }
+
+EMSCRIPTEN_KEEPALIVE
+size_t ocrlib_engine_last_error(const ocrlib_engine* engine, char* buf,
+                                size_t capacity) {
+  return copy_to_buffer(engine->last_error, buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_load_model(ocrlib_engine* engine, const uint8_t* data,
+                                 size_t size, const char* lang) {
+  engine->results.reset();
+  auto result = set_result(engine, engine->engine.LoadModel(data, size, lang));
+  engine->model_loaded = result == 0;
+  return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_set_variable(ocrlib_engine* engine, const char* name,
+                                   const char* value) {
+  return set_result(engine, engine->engine.SetVariable(name, value));
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_variable(ocrlib_engine* engine, const char* name,
+                                   char* buf, size_t capacity) {
+  auto result = engine->engine.GetVariable(name);
+  if (!result.success) {
+    engine->last_error = std::string("Unable to get variable ") + name;
+    return -1;
+  }
+  return copy_to_buffer(result.value, buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_load_image(ocrlib_engine* engine, const uint8_t* data,
+                                 size_t size, int32_t remove_underlines) {
+  LoadImageOptions options;
+  options.underlines = underline_mode_from_int(remove_underlines);
+
+  engine->results.reset();
+  auto result =
+      set_result(engine, engine->engine.LoadImage(data, size, options));
+  engine->image_loaded = result == 0;
+  return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_load_image_with_options(
+    ocrlib_engine* engine, const uint8_t* data, size_t size,
+    const ocrlib_load_options* c_options) {
+  LoadImageOptions options;
+  options.underlines = underline_mode_from_int(c_options->remove_underlines);
+  options.auto_orient = c_options->auto_orient != 0;
+  if (!preprocess_steps_from_c(c_options->preprocess,
+                               c_options->preprocess_count,
+                               options.preprocess)) {
+    engine->last_error = "Invalid preprocessing step";
+    return -1;
+  }
+
+  engine->results.reset();
+  auto result =
+      set_result(engine, engine->engine.LoadImage(data, size, options));
+  engine->image_loaded = result == 0;
+  return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_load_raw_image(ocrlib_engine* engine,
+                                     const uint8_t* pixels, size_t size,
+                                     int32_t width, int32_t height,
+                                     int32_t bytes_per_pixel, int32_t stride,
+                                     int32_t remove_underlines) {
+  LoadImageOptions options;
+  options.underlines = underline_mode_from_int(remove_underlines);
+
+  engine->results.reset();
+  auto result = set_result(
+      engine, engine->engine.LoadRawImage(pixels, size, width, height,
+                                          bytes_per_pixel, stride, options));
+  engine->image_loaded = result == 0;
+  return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_load_raw_image_with_options(
+    ocrlib_engine* engine, const uint8_t* pixels, size_t size, int32_t width,
+    int32_t height, int32_t bytes_per_pixel, int32_t stride,
+    const ocrlib_load_options* c_options) {
+  LoadImageOptions options;
+  options.underlines = underline_mode_from_int(c_options->remove_underlines);
+  options.auto_orient = c_options->auto_orient != 0;
+  if (!preprocess_steps_from_c(c_options->preprocess,
+                               c_options->preprocess_count,
+                               options.preprocess)) {
+    engine->last_error = "Invalid preprocessing step";
+    return -1;
+  }
+
+  engine->results.reset();
+  auto result = set_result(
+      engine, engine->engine.LoadRawImage(pixels, size, width, height,
+                                          bytes_per_pixel, stride, options));
+  engine->image_loaded = result == 0;
+  return result;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void ocrlib_engine_clear_image(ocrlib_engine* engine) {
+  engine->engine.ClearImage();
+  engine->image_loaded = false;
+  engine->results.reset();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_recognize(ocrlib_engine* engine,
+                                ocrlib_progress_callback progress,
+                                void* user_data) {
+  if (!check_image_loaded(engine) || !check_model_loaded(engine)) {
+    return -1;
+  }
+  ProgressCallback callback;
+  if (progress) {
+    callback = [=](int percentage) { progress(percentage, user_data); };
+  }
+  engine->engine.Recognize(callback);
+  return 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_text(ocrlib_engine* engine, char* buf,
+                               size_t capacity) {
+  if (!check_image_loaded(engine) || !check_model_loaded(engine)) {
+    return -1;
+  }
+  return copy_to_buffer(engine->engine.GetText(), buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_hocr(ocrlib_engine* engine, char* buf,
+                               size_t capacity) {
+  if (!check_image_loaded(engine) || !check_model_loaded(engine)) {
+    return -1;
+  }
+  return copy_to_buffer(engine->engine.GetHOCR(), buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_boxes(ocrlib_engine* engine, int32_t unit,
+                                int32_t with_text, ocrlib_box* boxes,
+                                size_t max_boxes, char* text,
+                                size_t text_capacity, size_t* text_size) {
+  if (unit != OCRLIB_UNIT_WORD && unit != OCRLIB_UNIT_LINE) {
+    engine->last_error = "Invalid text unit";
+    return -1;
+  }
+  if (!check_image_loaded(engine) ||
+      (with_text && !check_model_loaded(engine))) {
+    return -1;
+  }
+
+  auto text_unit = unit == OCRLIB_UNIT_LINE ? TextUnit::Line : TextUnit::Word;
+  auto items = with_text ? engine->engine.GetTextBoxes(text_unit)
+                         : engine->engine.GetBoundingBoxes(text_unit);
+
+  size_t text_offset = 0;
+  for (size_t i = 0; i < items.size(); i++) {
+    const auto& item = items[i];
+    if (i < max_boxes) {
+      boxes[i] = {
+          .left = item.rect.left,
+          .top = item.rect.top,
+          .right = item.rect.right,
+          .bottom = item.rect.bottom,
+          .flags = item.flags,
+          .confidence = item.confidence,
+          .text_offset = uint32_t(text_offset),
+          .text_length = uint32_t(item.text.size()),
+      };
+      if (text_offset + item.text.size() <= text_capacity) {
+        memcpy(text + text_offset, item.text.data(), item.text.size());
+      }
+    }
+    text_offset += item.text.size();
+  }
+  if (text_size) {
+    *text_size = text_offset;
+  }
+  return items.size();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_results(ocrlib_engine* engine, int32_t formats,
+                                  uint8_t* buf, size_t capacity) {
+  if (!check_image_loaded(engine) || !check_model_loaded(engine)) {
+    return -1;
+  }
+  ocrlib_engine::ResultsKey key = {.formats = formats};
+  if (!engine->results || engine->results_key != key) {
+    engine->results = engine->engine.GetResults(formats);
+    engine->results_key = std::move(key);
+  }
+  return copy_results(engine, buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_recognize_regions(ocrlib_engine* engine,
+                                        const ocrlib_rect* regions,
+                                        size_t count, int32_t formats,
+                                        uint8_t* buf, size_t capacity) {
+  if (!check_image_loaded(engine) || !check_model_loaded(engine)) {
+    return -1;
+  }
+  ocrlib_engine::ResultsKey key = {
+      .source = ocrlib_engine::ResultsKey::Source::Regions,
+      .formats = formats,
+      .rects = rects_from_c(regions, count),
+  };
+  if (!engine->results || engine->results_key != key) {
+    engine->results = engine->engine.RecognizeRegions(key.rects, formats);
+    if (!engine->results) {
+      engine->last_error = engine->engine.CheckCanRecognize();
+      return -1;
+    }
+    engine->results_key = std::move(key);
+  }
+  return copy_results(engine, buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_recognize_lines(ocrlib_engine* engine,
+                                      const ocrlib_rect* lines, size_t count,
+                                      uint8_t* buf, size_t capacity) {
+  if (!check_image_loaded(engine) || !check_model_loaded(engine)) {
+    return -1;
+  }
+  ocrlib_engine::ResultsKey key = {
+      .source = ocrlib_engine::ResultsKey::Source::Lines,
+      .rects = rects_from_c(lines, count),
+  };
+  if (!engine->results || engine->results_key != key) {
+    engine->results = engine->engine.RecognizeLinesPacked(key.rects);
+    if (!engine->results) {
+      engine->last_error = engine->engine.CheckCanRecognize();
+      return -1;
+    }
+    engine->results_key = std::move(key);
+  }
+  return copy_results(engine, buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_recognize_batch(ocrlib_engine* engine,
+                                      const uint8_t* input, size_t size,
+                                      int32_t psm, int32_t formats,
+                                      uint8_t* buf, size_t capacity) {
+  if (!check_model_loaded(engine)) {
+    return -1;
+  }
+  ocrlib_engine::ResultsKey key = {
+      .source = ocrlib_engine::ResultsKey::Source::Batch,
+      .formats = formats,
+      .psm = psm,
+      .batch = input,
+      .batch_size = size,
+  };
+  if (!engine->results || engine->results_key != key) {
+    engine->results =
+        engine->engine.RecognizeBatch(input, size, psm, formats);
+    if (!engine->results) {
+      engine->last_error = "Invalid batch";
+      return -1;
+    }
+    engine->results_key = std::move(key);
+  }
+  return copy_results(engine, buf, capacity);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_orientation(ocrlib_engine* engine,
+                                      int32_t* rotation, float* confidence) {
+  if (!check_image_loaded(engine)) {
+    return -1;
+  }
+  auto orientation = engine->engine.GetOrientation();
+  *rotation = orientation.rotation;
+  *confidence = orientation.confidence;
+  return 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+void ocrlib_engine_set_memory_budget(ocrlib_engine* engine, size_t bytes) {
+  engine->engine.SetMemoryBudget(bytes);
+}
+
+EMSCRIPTEN_KEEPALIVE
+void ocrlib_engine_set_tile_size(ocrlib_engine* engine, int32_t size,
+                                 int32_t overlap) {
+  engine->engine.SetTileSize(size, overlap);
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_image_scale(ocrlib_engine* engine, float* scale) {
+  if (!check_image_loaded(engine)) {
+    return -1;
+  }
+  *scale = engine->engine.GetImageScale();
+  return 0;
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_applied_rotation(ocrlib_engine* engine) {
+  if (!check_image_loaded(engine)) {
+    return -1;
+  }
+  return engine->engine.GetAppliedRotation();
+}
+
+EMSCRIPTEN_KEEPALIVE
+int32_t ocrlib_engine_get_skew(ocrlib_engine* engine, float* angle,
+                               float* confidence) {
+  if (!check_image_loaded(engine)) {
+    return -1;
+  }
+  auto skew = engine->engine.GetSkew();
+  *angle = skew.angle;
+  *confidence = skew.confidence;
+  return 0;
+}
+
+}  // extern "C"
+
+#ifdef OCRLIB_SNAPSHOT_LANG
+
+// Functions for the snapshot build, which is pre-initialized using Wizer
+// (https://github.com/bytecodealliance/wizer) with an engine that has already
+// loaded a model. See the Makefile.
+
+// Model to load into the snapshot engine, generated from a `.traineddata` file
+// using `xxd -i`.
+unsigned char snapshot_model[] = {
+#include "snapshot-model.inc"
 };
 
+ocrlib_engine* snapshot_engine = nullptr;
+
+extern "C" {
+
+void __wasm_call_ctors();
+
+// Called by Wizer to initialize the module before its memory is snapshotted.
+EMSCRIPTEN_KEEPALIVE
+void ocrlib_snapshot_init() {
+  // Wizer calls this instead of `_initialize`, which is replaced by
+  // `ocrlib_snapshot_resume` in the snapshot so that static constructors are
+  // not run again.
+  __wasm_call_ctors();
+
+  snapshot_engine = ocrlib_engine_create();
+  if (ocrlib_engine_load_model(snapshot_engine, snapshot_model,
+                               sizeof(snapshot_model),
+                               OCRLIB_SNAPSHOT_LANG) != 0) {
+    abort();
+  }
+
+  // Tesseract does not use the model data once loaded. Wizer leaves zeroed
+  // memory out of the snapshot, so clearing it removes the model data from
+  // the output binary.
+  memset(snapshot_model, 0, sizeof(snapshot_model));
+}
+
+EMSCRIPTEN_KEEPALIVE
+void ocrlib_snapshot_resume() {}
+
+EMSCRIPTEN_KEEPALIVE
+ocrlib_engine* ocrlib_snapshot_engine() { return snapshot_engine; }
+
+}  // extern "C"
+
+#endif  // OCRLIB_SNAPSHOT_LANG
+
+#ifndef OCRLIB_NO_EMBIND
+
+using namespace emscripten;
+
+// Adapt a JS progress callback, which may be undefined, for use with
+// OCREngine.
+ProgressCallback progress_callback_from_val(const val& callback) {
+  if (callback.isUndefined()) {
+    return {};
+  }
+  return [callback](int percentage) { callback(percentage); };
+}
+
 EMSCRIPTEN_BINDINGS(ocrlib) {
   value_object<IntRect>("IntRect")
       .field("left", &IntRect::left)
@@ -394,6 +3296,19 @@ EMSCRIPTEN_BINDINGS(ocrlib) {
       .field("rotation", &Orientation::rotation)
       .field("confidence", &Orientation::confidence);
 
+  value_object<Skew>("Skew")
+      .field("angle", &Skew::angle)
+      .field("confidence", &Skew::confidence);
+
+  value_object<PreprocessStep>("PreprocessStep")
+      .field("op", &PreprocessStep::op)
+      .field("value", &PreprocessStep::value);
+
+  value_object<LoadImageOptions>("LoadImageOptions")
+      .field("underlines", &LoadImageOptions::underlines)
+      .field("autoOrient", &LoadImageOptions::auto_orient)
+      .field("preprocess", &LoadImageOptions::preprocess);
+
   value_object<GetVariableResult>("GetVariableResult")
       .field("success", &GetVariableResult::success)
       .field("value", &GetVariableResult::value);
@@ -407,19 +3322,94 @@ EMSCRIPTEN_BINDINGS(ocrlib) {
       .constructor<>()
       .function("clearImage", &OCREngine::ClearImage)
       .function("getBoundingBoxes", &OCREngine::GetBoundingBoxes)
-      .function("getHOCR", &OCREngine::GetHOCR)
+      .function("getBoundingBoxesPacked", &OCREngine::GetBoundingBoxesPacked)
+      .function("getHOCR",
+                optional_override([](OCREngine& engine, const val& callback) {
+                  return engine.GetHOCR(progress_callback_from_val(callback));
+                }))
       .function("getOrientation", &OCREngine::GetOrientation)
-      .function("getText", &OCREngine::GetText)
-      .function("getTextBoxes", &OCREngine::GetTextBoxes)
+      .function("getSkew", &OCREngine::GetSkew)
+      .function("getImageScale", &OCREngine::GetImageScale)
+      .function("setMemoryBudget", &OCREngine::SetMemoryBudget)
+      .function("setTileSize", &OCREngine::SetTileSize)
+      .function("getAppliedRotation", &OCREngine::GetAppliedRotation)
+      .function("getResults",
+                optional_override([](OCREngine& engine, ResultFormats formats,
+                                     const val& callback) {
+                  return engine.GetResults(
+                      formats, progress_callback_from_val(callback));
+                }))
+      .function("recognizeRegions",
+                optional_override([](OCREngine& engine,
+                                     const std::vector<IntRect>& regions,
+                                     ResultFormats formats,
+                                     const val& callback) {
+                  return engine.RecognizeRegions(
+                      regions, formats, progress_callback_from_val(callback));
+                }))
+      .function("recognizeLinesPacked",
+                optional_override([](OCREngine& engine,
+                                     const std::vector<IntRect>& lines,
+                                     const val& callback) {
+                  return engine.RecognizeLinesPacked(
+                      lines, progress_callback_from_val(callback));
+                }))
+      .function("recognizeBatch",
+                optional_override([](OCREngine& engine, const ByteView& data,
+                                     int psm, ResultFormats formats,
+                                     const val& callback) {
+                  return engine.RecognizeBatch(
+                      data, psm, formats, progress_callback_from_val(callback));
+                }))
+      .function("getText",
+                optional_override([](OCREngine& engine, const val& callback) {
+                  return engine.GetText(progress_callback_from_val(callback));
+                }))
+      .function("getTextBoxes",
+                optional_override([](OCREngine& engine, TextUnit unit,
+                                     const val& callback) {
+                  return engine.GetTextBoxes(
+                      unit, progress_callback_from_val(callback));
+                }))
+      .function("getTextBoxesPacked",
+                optional_override([](OCREngine& engine, TextUnit unit,
+                                     const val& callback) {
+                  return engine.GetTextBoxesPacked(
+                      unit, progress_callback_from_val(callback));
+                }))
       .function("getVariable", &OCREngine::GetVariable)
-      .function("loadImage", &OCREngine::LoadImage)
-      .function("loadModel", &OCREngine::LoadModel)
+      .function("loadImage",
+                select_overload<OCRResult(const ByteView&,
+                                          const LoadImageOptions&)>(
+                    &OCREngine::LoadImage))
+      .function("loadRawImage",
+                select_overload<OCRResult(const ByteView&, int, int, int, int,
+                                          const LoadImageOptions&)>(
+                    &OCREngine::LoadRawImage))
+      .function("loadModel",
+                select_overload<OCRResult(const ByteView&, const std::string&)>(
+                    &OCREngine::LoadModel))
       .function("setVariable", &OCREngine::SetVariable);
 
   enum_<TextUnit>("TextUnit")
       .value("Line", TextUnit::Line)
       .value("Word", TextUnit::Word);
 
+  enum_<UnderlineMode>("UnderlineMode")
+      .value("Keep", UnderlineMode::Keep)
+      .value("Remove", UnderlineMode::Remove)
+      .value("Auto", UnderlineMode::Auto);
+
+  enum_<PreprocessOp>("PreprocessOp")
+      .value("Deskew", PreprocessOp::Deskew)
+      .value("ScaleToDPI", PreprocessOp::ScaleToDPI)
+      .value("Denoise", PreprocessOp::Denoise)
+      .value("NormalizeContrast", PreprocessOp::NormalizeContrast)
+      .value("RemoveBorder", PreprocessOp::RemoveBorder);
+
   register_vector<IntRect>("vector<IntRect>");
   register_vector<TextRect>("vector<TextRect>");
+  register_vector<PreprocessStep>("vector<PreprocessStep>");
 }
+
+#endif  // OCRLIB_NO_EMBIND
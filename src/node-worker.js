@@ -7,7 +7,11 @@ import { expose, proxy } from "comlink";
 // @ts-ignore
 import nodeEndpoint from "comlink/dist/esm/node-adapter.mjs";
 
-import { createOCREngine, OCRClient } from "../dist/lib.js";
+import {
+  createOCREngine,
+  OCRClient,
+  supportsRelaxedSIMDBuild,
+} from "../dist/lib.js";
 
 /**
  * Resolve a path against the location of the current module.
@@ -20,9 +24,20 @@ export function resolve(path, moduleURL = import.meta.url) {
 
 /**
  * Load the compiled WebAssembly binary from the tesseract-wasm package.
+ *
+ * The relaxed SIMD build is used if the Node version supports it, unless the
+ * multi-threaded build is requested with `threads`.
  */
-export function loadWasmBinary() {
-  return readFile(resolve("../dist/tesseract-core.wasm"));
+export function loadWasmBinary({ threads = false } = {}) {
+  let wasmFile;
+  if (threads) {
+    wasmFile = "tesseract-core-mt.wasm";
+  } else if (supportsRelaxedSIMDBuild()) {
+    wasmFile = "tesseract-core-relaxed.wasm";
+  } else {
+    wasmFile = "tesseract-core.wasm";
+  }
+  return readFile(resolve(`../dist/${wasmFile}`));
 }
 
 /**
@@ -41,13 +56,18 @@ if (!isMainThread) {
     /**
      * @param {object} options
      *   @param {Uint8Array|ArrayBuffer} [options.wasmBinary]
+     *   @param {boolean} [options.threads]
      * @param {MessagePort} [progressChannel]
      */
-    createOCREngine: async ({ wasmBinary }, progressChannel) => {
+    createOCREngine: async ({ wasmBinary, threads }, progressChannel) => {
       if (!wasmBinary) {
-        wasmBinary = await loadWasmBinary();
+        wasmBinary = await loadWasmBinary({ threads });
       }
-      const engine = await createOCREngine({ wasmBinary, progressChannel });
+      const engine = await createOCREngine({
+        wasmBinary,
+        progressChannel,
+        threads,
+      });
       return proxy(engine);
     },
   };
@@ -1,9 +1,17 @@
 import * as comlink from "comlink";
 
 import type {
+  BatchResults,
   BoxItem,
+  IntRect,
+  LoadImageOptions,
   Orientation,
   ProgressListener,
+  RecognizeBatchOptions,
+  RegionResults,
+  ResultFormat,
+  Results,
+  Skew,
   TextItem,
   TextUnit,
 } from "./ocr-engine";
@@ -36,6 +44,13 @@ export type OCRClientInit = {
    */
   wasmBinary?: Uint8Array | ArrayBuffer;
 
+  /**
+   * Use the multi-threaded build in the worker, which recognizes parts of a
+   * page concurrently. The runtime must support shared memory. If
+   * `wasmBinary` is set, it must be `tesseract-core-mt.wasm`.
+   */
+  threads?: boolean;
+
   /**
    * Location of worker script/module. If not set, it is loaded from the default location relative to the
    * current script.
@@ -66,6 +81,7 @@ export class OCRClient {
   constructor({
     createWorker = createWebWorker,
     wasmBinary,
+    threads,
     workerURL = defaultWorkerURL(),
   }: OCRClientInit = {}) {
     const worker = createWorker(workerURL);
@@ -109,6 +125,7 @@ export class OCRClient {
     this._ocrEngine = (remote as any).createOCREngine(
       {
         wasmBinary,
+        threads,
       },
       comlink.transfer(port2, [port2])
     );
@@ -135,7 +152,10 @@ export class OCRClient {
   /**
    * Load an image into the OCR engine for processing.
    */
-  async loadImage(image: ImageBitmap | ImageData): Promise<void> {
+  async loadImage(
+    image: ImageBitmap | ImageData,
+    options?: LoadImageOptions
+  ): Promise<void> {
     // Convert ImageBitmap to ImageData. In browsers that don't support
     // OffscreenCanvas (Firefox and Safari as of 2022-06) we have to do this
     // on the main thread using a canvas. In Chrome, we still do this on the
@@ -146,7 +166,7 @@ export class OCRClient {
       image = imageDataFromBitmap(image);
     }
     const engine = await this._ocrEngine;
-    return engine.loadImage(image);
+    return engine.loadImage(image, options);
   }
 
   /**
@@ -164,6 +184,33 @@ export class OCRClient {
     return engine.clearImage();
   }
 
+  /**
+   * Limit the memory used to load and process each image. See
+   * {@link OCREngine.setMemoryBudget}.
+   */
+  async setMemoryBudget(bytes: number): Promise<void> {
+    const engine = await this._ocrEngine;
+    return engine.setMemoryBudget(bytes);
+  }
+
+  /**
+   * Recognize large images in overlapping tiles. See
+   * {@link OCREngine.setTileSize}.
+   */
+  async setTileSize(size: number, overlap = 0): Promise<void> {
+    const engine = await this._ocrEngine;
+    return engine.setTileSize(size, overlap);
+  }
+
+  /**
+   * Return the factor by which the current image was scaled down to fit the
+   * memory budget. See {@link OCREngine.getImageScale}.
+   */
+  async getImageScale(): Promise<number> {
+    const engine = await this._ocrEngine;
+    return engine.getImageScale();
+  }
+
   /**
    * Perform layout analysis on the current image, if not already done, and
    * return bounding boxes for a given unit of text.
@@ -237,6 +284,101 @@ export class OCRClient {
     }
   }
 
+  /**
+   * Perform layout analysis and text recognition on the current image, if
+   * not already done, and return the results in several formats at once.
+   *
+   * This is faster than calling {@link getText}, {@link getHOCR} and
+   * {@link getTextBoxes} separately.
+   */
+  async getResults(
+    formats: ResultFormat[],
+    onProgress?: ProgressListener
+  ): Promise<Results> {
+    const engine = await this._ocrEngine;
+    if (onProgress) {
+      this._addProgressListener(onProgress);
+    }
+    try {
+      return await engine.getResults(formats);
+    } finally {
+      if (onProgress) {
+        this._removeProgressListener(onProgress);
+      }
+    }
+  }
+
+  /**
+   * Recognize only the given regions of the current image. See
+   * {@link OCREngine.recognizeRegions}.
+   */
+  async recognizeRegions(
+    regions: IntRect[],
+    formats: ResultFormat[],
+    onProgress?: ProgressListener
+  ): Promise<RegionResults[]> {
+    const engine = await this._ocrEngine;
+    if (onProgress) {
+      this._addProgressListener(onProgress);
+    }
+    try {
+      return await engine.recognizeRegions(regions, formats);
+    } finally {
+      if (onProgress) {
+        this._removeProgressListener(onProgress);
+      }
+    }
+  }
+
+  /**
+   * Recognize lines of text that have already been located, skipping layout
+   * analysis. See {@link OCREngine.recognizeLines}.
+   */
+  async recognizeLines(
+    lines: IntRect[],
+    onProgress?: ProgressListener
+  ): Promise<TextItem[]> {
+    const engine = await this._ocrEngine;
+    if (onProgress) {
+      this._addProgressListener(onProgress);
+    }
+    try {
+      return await engine.recognizeLines(lines);
+    } finally {
+      if (onProgress) {
+        this._removeProgressListener(onProgress);
+      }
+    }
+  }
+
+  /**
+   * Recognize each of a batch of small images in a single call. See
+   * {@link OCREngine.recognizeBatch}.
+   */
+  async recognizeBatch(
+    images: Array<ImageBitmap | ImageData>,
+    formats: ResultFormat[],
+    options: RecognizeBatchOptions = {},
+    onProgress?: ProgressListener
+  ): Promise<BatchResults[]> {
+    const engine = await this._ocrEngine;
+    const imageData = images.map((image) =>
+      typeof ImageBitmap !== "undefined" && image instanceof ImageBitmap
+        ? imageDataFromBitmap(image)
+        : (image as ImageData)
+    );
+    if (onProgress) {
+      this._addProgressListener(onProgress);
+    }
+    try {
+      return await engine.recognizeBatch(imageData, formats, options);
+    } finally {
+      if (onProgress) {
+        this._removeProgressListener(onProgress);
+      }
+    }
+  }
+
   /**
    * Attempt to determine the orientation of the image.
    *
@@ -251,6 +393,24 @@ export class OCRClient {
     return engine.getOrientation();
   }
 
+  /**
+   * Return the skew that the "deskew" preprocessing step measured when the
+   * current image was loaded.
+   */
+  async getSkew(): Promise<Skew> {
+    const engine = await this._ocrEngine;
+    return engine.getSkew();
+  }
+
+  /**
+   * Return the clockwise rotation, in degrees, that the `autoOrient` option
+   * detected in the current image and corrected.
+   */
+  async getAppliedRotation(): Promise<number> {
+    const engine = await this._ocrEngine;
+    return engine.getAppliedRotation();
+  }
+
   private _addProgressListener(listener: ProgressListener) {
     this._progressListeners.push(listener);
   }
@@ -4,26 +4,226 @@ import initTesseractCore from "../build/tesseract-core";
 import { imageDataFromBitmap } from "./utils";
 
 /**
- * JS interface to a `std::vector` returned from a C++ method wrapped by
- * Embind.
+ * JS interface to a `ByteView` returned from a C++ method wrapped by Embind.
  */
-type StdVector<T> = {
-  size: () => number;
-  get: (index: number) => T;
+type ByteView = {
+  data: () => Uint8Array;
+  OOM: () => boolean;
+  delete: () => void;
 };
 
 /**
- * Create a JS array from a std::vector wrapper created by Embind.
+ * Decode a packed buffer of boxes, as returned by `getBoundingBoxesPacked` or
+ * `getTextBoxesPacked`, or a box section of the buffer returned by
+ * `getResults`.
+ *
+ * Keep this in sync with `ocrlib_packed_boxes_header` and `ocrlib_box` in
+ * capi.h.
  */
-function jsArrayFromStdVector<T>(vec: StdVector<T>): T[] {
-  const size = vec.size();
+function decodePackedBoxes(bytes: Uint8Array, decoder: TextDecoder): TextItem[] {
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const count = view.getUint32(0, true);
+  const recordSize = view.getUint32(4, true);
+  const recordsOffset = view.getUint32(8, true);
+  const stringsOffset = view.getUint32(12, true);
+
   const result = [];
-  for (let i = 0; i < size; i++) {
-    result.push(vec.get(i));
+  for (let i = 0; i < count; i++) {
+    const offset = recordsOffset + i * recordSize;
+    const textStart = stringsOffset + view.getUint32(offset + 24, true);
+    const textEnd = textStart + view.getUint32(offset + 28, true);
+    result.push({
+      rect: {
+        left: view.getInt32(offset, true),
+        top: view.getInt32(offset + 4, true),
+        right: view.getInt32(offset + 8, true),
+        bottom: view.getInt32(offset + 12, true),
+      },
+      flags: view.getInt32(offset + 16, true),
+      confidence: view.getFloat32(offset + 20, true),
+      text: decoder.decode(bytes.subarray(textStart, textEnd)),
+    });
   }
   return result;
 }
 
+/**
+ * Create a JS array from a packed buffer of boxes returned by
+ * `getBoundingBoxesPacked`, `getTextBoxesPacked` or `recognizeLinesPacked`,
+ * and free the buffer.
+ */
+function jsArrayFromPackedBoxes(packed: ByteView): TextItem[] {
+  try {
+    if (packed.OOM()) {
+      throw new Error("Failed to allocate memory for results");
+    }
+    return decodePackedBoxes(packed.data(), new TextDecoder());
+  } finally {
+    packed.delete();
+  }
+}
+
+/**
+ * Bit flags for the formats requested from `getResults`.
+ *
+ * Keep this in sync with `ResultFormat` in lib.cpp.
+ */
+const resultFormatFlags = {
+  text: 1,
+  words: 2,
+  lines: 4,
+  hocr: 8,
+};
+
+/**
+ * Tesseract page segmentation modes for each batch layout.
+ *
+ * Keep this in sync with `PageSegMode` in Tesseract's publictypes.h.
+ */
+const batchLayoutModes: Record<BatchLayout, number> = {
+  block: 6,
+  line: 7,
+  word: 8,
+  char: 10,
+};
+
+/**
+ * Decode a results buffer produced by `getResults`.
+ *
+ * Keep this in sync with `ocrlib_results_header` in capi.h.
+ */
+function decodeResults(
+  bytes: Uint8Array,
+  formats: ResultFormat[],
+  decoder: TextDecoder
+): Results {
+  const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+  const section = (index: number) => {
+    const offset = view.getUint32(index * 8, true);
+    const size = view.getUint32(index * 8 + 4, true);
+    return bytes.subarray(offset, offset + size);
+  };
+
+  const results: Results = {};
+  if (formats.includes("text")) {
+    results.text = decoder.decode(section(0));
+  }
+  if (formats.includes("hocr")) {
+    results.hocr = decoder.decode(section(1));
+  }
+  if (formats.includes("words")) {
+    results.words = decodePackedBoxes(section(2), decoder);
+  }
+  if (formats.includes("lines")) {
+    results.lines = decodePackedBoxes(section(3), decoder);
+  }
+  return results;
+}
+
+/**
+ * Decode the buffer returned by `getResults`, and free the buffer.
+ */
+function resultsFromPacked(packed: ByteView, formats: ResultFormat[]): Results {
+  try {
+    if (packed.OOM()) {
+      throw new Error("Failed to allocate memory for results");
+    }
+    return decodeResults(packed.data(), formats, new TextDecoder());
+  } finally {
+    packed.delete();
+  }
+}
+
+/**
+ * Decode the buffer returned by `recognizeRegions`, and free the buffer.
+ *
+ * Keep this in sync with `ocrlib_regions_header` in capi.h.
+ */
+function regionResultsFromPacked(
+  packed: ByteView,
+  formats: ResultFormat[]
+): RegionResults[] {
+  try {
+    if (packed.OOM()) {
+      throw new Error("Failed to allocate memory for results");
+    }
+    const bytes = packed.data();
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    const count = view.getUint32(0, true);
+    const recordSize = view.getUint32(4, true);
+    const recordsOffset = view.getUint32(8, true);
+
+    const decoder = new TextDecoder();
+    const regions: RegionResults[] = [];
+    for (let i = 0; i < count; i++) {
+      const offset = recordsOffset + i * recordSize;
+      const resultsOffset = view.getUint32(offset + 16, true);
+      const resultsSize = view.getUint32(offset + 20, true);
+      const results = decodeResults(
+        bytes.subarray(resultsOffset, resultsOffset + resultsSize),
+        formats,
+        decoder
+      );
+      regions.push({
+        ...results,
+        rect: {
+          left: view.getInt32(offset, true),
+          top: view.getInt32(offset + 4, true),
+          right: view.getInt32(offset + 8, true),
+          bottom: view.getInt32(offset + 12, true),
+        },
+      });
+    }
+    return regions;
+  } finally {
+    packed.delete();
+  }
+}
+
+/**
+ * Decode the buffer returned by `recognizeBatch`, and free the buffer.
+ *
+ * Keep this in sync with `ocrlib_batch_header` and `ocrlib_batch_result` in
+ * capi.h.
+ */
+function batchResultsFromPacked(
+  packed: ByteView,
+  formats: ResultFormat[]
+): BatchResults[] {
+  try {
+    if (packed.OOM()) {
+      throw new Error("Failed to allocate memory for results");
+    }
+    const bytes = packed.data();
+    const view = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength);
+    const count = view.getUint32(0, true);
+    const recordSize = view.getUint32(4, true);
+    const recordsOffset = view.getUint32(8, true);
+
+    const decoder = new TextDecoder();
+    const batch: BatchResults[] = [];
+    for (let i = 0; i < count; i++) {
+      const offset = recordsOffset + i * recordSize;
+      if (view.getInt32(offset, true) !== 0) {
+        batch.push({ error: "Failed to recognize image" });
+        continue;
+      }
+      const resultsOffset = view.getUint32(offset + 4, true);
+      const resultsSize = view.getUint32(offset + 8, true);
+      batch.push(
+        decodeResults(
+          bytes.subarray(resultsOffset, resultsOffset + resultsSize),
+          formats,
+          decoder
+        )
+      );
+    }
+    return batch;
+  } finally {
+    packed.delete();
+  }
+}
+
 /**
  * Flags indicating position of a text item.
  *
@@ -76,8 +276,129 @@ export type Orientation = {
   confidence: number;
 };
 
+/**
+ * Skew of an image, as measured by the "deskew" preprocessing step.
+ */
+export type Skew = {
+  /** Angle in degrees. Positive angles are clockwise. */
+  angle: number;
+
+  /**
+   * Confidence score for the angle. The image is only rotated if this is at
+   * least 3 and the angle is at least 0.1 degrees.
+   */
+  confidence: number;
+};
+
 export type TextUnit = "line" | "word";
 
+/**
+ * Output format that can be requested from {@link OCREngine.getResults}.
+ *
+ * "words" and "lines" correspond to {@link OCREngine.getTextBoxes} with the
+ * "word" and "line" units.
+ */
+export type ResultFormat = "text" | "hocr" | "words" | "lines";
+
+/**
+ * Results returned by {@link OCREngine.getResults}. Only the requested formats
+ * are set.
+ */
+export type Results = {
+  text?: string;
+  hocr?: string;
+  words?: TextItem[];
+  lines?: TextItem[];
+};
+
+/**
+ * Results for one region, returned by {@link OCREngine.recognizeRegions}.
+ */
+export type RegionResults = Results & {
+  /** The region, clipped to the image. */
+  rect: IntRect;
+};
+
+/**
+ * Results for one image, returned by {@link OCREngine.recognizeBatch}. If the
+ * image could not be recognized, `error` is set instead of the results.
+ */
+export type BatchResults = Results & {
+  error?: string;
+};
+
+/**
+ * How each image in a batch is segmented before recognition.
+ *
+ * - "block": A single uniform block of text
+ * - "line": A single line of text
+ * - "word": A single word
+ * - "char": A single character
+ */
+export type BatchLayout = "block" | "line" | "word" | "char";
+
+/**
+ * Options for {@link OCREngine.recognizeBatch}.
+ */
+export type RecognizeBatchOptions = {
+  /**
+   * How each image is segmented. By default the full layout analysis used for
+   * pages is performed. Setting this is faster and more accurate when all the
+   * images have the same kind of content, such as fields cropped from a form.
+   */
+  layout?: BatchLayout;
+};
+
+/**
+ * Image preprocessing operation.
+ *
+ * - "deskew": Correct small rotations of the page. The skew is searched for on
+ *   a binary copy of the image reduced by a factor of `value`, which is 1, 2
+ *   or 4. Defaults to 2. Use {@link OCREngine.getSkew} to get the skew.
+ * - "scale-to-dpi": Scale the image to `value` DPI. Does nothing if the image
+ *   does not specify its resolution.
+ * - "denoise": Apply a `value` x `value` median filter. Defaults to 3.
+ * - "normalize-contrast": Normalize contrast in tiles of `value` x `value`
+ *   pixels, converting the image to greyscale. Defaults to 50.
+ * - "remove-border": Remove `value` pixels from each edge of the image.
+ */
+export type PreprocessOp =
+  | "deskew"
+  | "scale-to-dpi"
+  | "denoise"
+  | "normalize-contrast"
+  | "remove-border";
+
+export type PreprocessStep = {
+  op: PreprocessOp;
+  value?: number;
+};
+
+/**
+ * Options for {@link OCREngine.loadImage}.
+ */
+export type LoadImageOptions = {
+  /**
+   * Detect the orientation of the page and rotate it upright before any
+   * preprocessing. The image is only rotated if the orientation is detected
+   * with high confidence. Use {@link OCREngine.getAppliedRotation} to get the
+   * rotation that was corrected.
+   */
+  autoOrient?: boolean;
+
+  /**
+   * Operations to apply to the image, in order, when it is loaded. These run
+   * inside the OCR engine, without extra copies of the image in JS.
+   */
+  preprocess?: PreprocessStep[];
+
+  /**
+   * Whether to remove underlines from the image after preprocessing. "auto"
+   * removes underlines only if the image appears to contain some.
+   */
+  removeUnderlines?: boolean | "auto";
+};
+
 /**
  * Handler that receives OCR operation progress updates.
  */
@@ -166,9 +487,10 @@ export class OCREngine {
    * Load a document image for processing by subsequent operations.
    *
    * This is a cheap operation as expensive processing is deferred until
-   * bounding boxes or text content is requested.
+   * bounding boxes or text content is requested, unless preprocessing is
+   * requested in `options`.
    */
-  loadImage(image: ImageBitmap | ImageData) {
+  loadImage(image: ImageBitmap | ImageData, options: LoadImageOptions = {}) {
     let imageData;
     if (typeof ImageBitmap !== "undefined" && image instanceof ImageBitmap) {
       imageData = imageDataFromBitmap(image);
@@ -184,26 +506,47 @@ export class OCREngine {
       throw new Error("Image width or height is zero");
     }
 
+    const engineOptions = this._loadImageOptions(options);
+
     // Free up resources used by the previous image, if any. Doing this before
     // creating the buffer for the new image reduces peak memory usage.
     this._engine.clearImage();
 
-    // Allocate a temporary internal image for transfering the image data into
-    // Tesseract
-    const engineImage = new this._tesseractLib.Image(
-      imageData.width,
-      imageData.height
-    );
-    const engineImageBuf = engineImage.data();
-    engineImageBuf.set(new Uint32Array(imageData.data.buffer));
+    // Copy the decoded RGBA pixels into a temporary buffer in the WASM heap
+    // and load them directly, which avoids re-encoding the image just so that
+    // Tesseract can decode it again.
+    const byteLength = imageData.width * imageData.height * 4;
+    const engineImage = new this._tesseractLib.ByteView(byteLength);
+    if (engineImage.OOM()) {
+      engineImage.delete();
+      engineOptions.preprocess.delete();
+      throw new Error("Failed to allocate memory for image");
+    }
+    engineImage
+      .data()
+      .set(
+        new Uint8Array(
+          imageData.data.buffer,
+          imageData.data.byteOffset,
+          byteLength
+        )
+      );
 
     // Load the image. This will take a copy of the image within Tesseract, so
     // we can release the original afterwards.
-    const result = this._engine.loadImage(engineImage);
+    const error = this._engine.loadRawImage(
+      engineImage,
+      imageData.width,
+      imageData.height,
+      4 /* bytes per pixel */,
+      imageData.width * 4 /* stride */,
+      engineOptions
+    );
     engineImage.delete();
+    engineOptions.preprocess.delete();
 
-    if (result.error) {
-      throw new Error("Failed to load image");
+    if (error) {
+      throw new Error(`Failed to load image: ${error}`);
     }
 
     this._imageLoaded = true;
@@ -224,6 +567,42 @@ export class OCREngine {
     this._imageLoaded = false;
   }
 
+  /**
+   * Limit the memory used to load and process each image to roughly `bytes`,
+   * not counting the text recognition model. Larger images are scaled down
+   * when loaded. Zero, the default, means no limit.
+   *
+   * Use {@link getImageScale} to map coordinates of results back to the
+   * original image.
+   */
+  setMemoryBudget(bytes: number) {
+    this._engine.setMemoryBudget(bytes);
+  }
+
+  /**
+   * Recognize images larger than `size` pixels in either dimension in tiles
+   * of `size` x `size` pixels, which overlap by `overlap` pixels, and merge
+   * the results. This bounds memory use by the tile size rather than the page
+   * size, and tiles are recognized concurrently in the multi-threaded build.
+   *
+   * The overlap should be larger than any word, and defaults to `size / 8`.
+   * A `size` of zero, the default, disables tiling. hOCR output is still
+   * produced from the whole page.
+   */
+  setTileSize(size: number, overlap = 0) {
+    this._engine.setTileSize(size, overlap);
+  }
+
+  /**
+   * Return the factor by which the current image was scaled down to fit the
+   * memory budget, or 1 if it was not. Divide the coordinates of results by
+   * this to get coordinates in the original image.
+   */
+  getImageScale(): number {
+    this._checkImageLoaded();
+    return this._engine.getImageScale();
+  }
+
   /**
    * Perform layout analysis on the current image, if not already done, and
    * return bounding boxes for a given unit of text.
@@ -241,7 +620,9 @@ export class OCREngine {
   getBoundingBoxes(unit: TextUnit): BoxItem[] {
     this._checkImageLoaded();
     const textUnit = this._textUnitForUnit(unit);
-    return jsArrayFromStdVector(this._engine.getBoundingBoxes(textUnit));
+    return jsArrayFromPackedBoxes(
+      this._engine.getBoundingBoxesPacked(textUnit)
+    );
   }
 
   /**
@@ -258,8 +639,8 @@ export class OCREngine {
 
     const textUnit = this._textUnitForUnit(unit);
 
-    return jsArrayFromStdVector(
-      this._engine.getTextBoxes(textUnit, (progress: number) => {
+    return jsArrayFromPackedBoxes(
+      this._engine.getTextBoxesPacked(textUnit, (progress: number) => {
         onProgress?.(progress);
         this._progressChannel?.postMessage({ progress });
       })
@@ -298,6 +679,205 @@ export class OCREngine {
     });
   }
 
+  /**
+   * Perform layout analysis and text recognition on the current image, if
+   * not already done, and return the results in several formats at once.
+   *
+   * This is equivalent to calling {@link getText}, {@link getHOCR} and
+   * {@link getTextBoxes} for each requested format, but is faster as the
+   * text and boxes are extracted in a single pass over the results.
+   *
+   * A text recognition model must be loaded with {@link loadModel} before this
+   * is called.
+   */
+  getResults(formats: ResultFormat[], onProgress?: ProgressListener): Results {
+    this._checkImageLoaded();
+    this._checkModelLoaded();
+
+    const formatFlags = this._resultFormatFlags(formats);
+    return resultsFromPacked(
+      this._engine.getResults(formatFlags, (progress: number) => {
+        onProgress?.(progress);
+        this._progressChannel?.postMessage({ progress });
+      }),
+      formats
+    );
+  }
+
+  /**
+   * Recognize each of `regions` of the current image on its own, and return
+   * the requested formats for each, in the same order as `regions`.
+   *
+   * This is much faster than {@link getResults} when only a few parts of the
+   * page are needed, as only those parts are recognized. Box coordinates are
+   * relative to the page. Regions are clipped to the image.
+   *
+   * A text recognition model must be loaded with {@link loadModel} before this
+   * is called.
+   */
+  recognizeRegions(
+    regions: IntRect[],
+    formats: ResultFormat[],
+    onProgress?: ProgressListener
+  ): RegionResults[] {
+    this._checkImageLoaded();
+    this._checkModelLoaded();
+
+    const formatFlags = this._resultFormatFlags(formats);
+    const engineRegions = new this._tesseractLib["vector<IntRect>"]();
+    try {
+      for (const { left, top, right, bottom } of regions) {
+        engineRegions.push_back({ left, top, right, bottom });
+      }
+      const packed = this._engine.recognizeRegions(
+        engineRegions,
+        formatFlags,
+        (progress: number) => {
+          onProgress?.(progress);
+          this._progressChannel?.postMessage({ progress });
+        }
+      );
+      if (!packed) {
+        throw new Error("Unable to recognize regions");
+      }
+      return regionResultsFromPacked(packed, formats);
+    } finally {
+      engineRegions.delete();
+    }
+  }
+
+  /**
+   * Recognize the text in each of `lines` of the current image, and return
+   * one item per line, in the same order, with the line's text and mean
+   * confidence.
+   *
+   * The lines are boxes around single lines of text that have already been
+   * found, eg. by a separate text detector. Page layout analysis is skipped,
+   * which makes this much faster than {@link getTextBoxes}. Boxes are
+   * clipped to the image.
+   *
+   * A text recognition model must be loaded with {@link loadModel} before this
+   * is called.
+   */
+  recognizeLines(lines: IntRect[], onProgress?: ProgressListener): TextItem[] {
+    this._checkImageLoaded();
+    this._checkModelLoaded();
+
+    const engineLines = new this._tesseractLib["vector<IntRect>"]();
+    try {
+      for (const { left, top, right, bottom } of lines) {
+        engineLines.push_back({ left, top, right, bottom });
+      }
+      const packed = this._engine.recognizeLinesPacked(
+        engineLines,
+        (progress: number) => {
+          onProgress?.(progress);
+          this._progressChannel?.postMessage({ progress });
+        }
+      );
+      if (!packed) {
+        throw new Error("Unable to recognize lines");
+      }
+      return jsArrayFromPackedBoxes(packed);
+    } finally {
+      engineLines.delete();
+    }
+  }
+
+  /**
+   * Recognize each of a batch of small images, such as text fields cropped
+   * from a form, and return the requested formats for each, in the same order
+   * as `images`.
+   *
+   * This is faster than loading and recognizing each image in turn, as the
+   * images are transferred and recognized in a single call, and concurrently
+   * in the multi-threaded build. The current image and its results are kept.
+   *
+   * A text recognition model must be loaded with {@link loadModel} before this
+   * is called.
+   */
+  recognizeBatch(
+    images: ImageData[],
+    formats: ResultFormat[],
+    options: RecognizeBatchOptions = {},
+    onProgress?: ProgressListener
+  ): BatchResults[] {
+    this._checkModelLoaded();
+
+    const formatFlags = this._resultFormatFlags(formats);
+    let psm = -1;
+    if (options.layout !== undefined) {
+      if (!(options.layout in batchLayoutModes)) {
+        throw new Error(`Invalid batch layout ${options.layout}`);
+      }
+      psm = batchLayoutModes[options.layout];
+    }
+
+    // Pack the images into one buffer, laid out as described by
+    // `ocrlib_batch_header` in capi.h, with each image's RGBA pixels 4-byte
+    // aligned.
+    const headerSize = 12;
+    const recordSize = 24;
+    let byteLength = headerSize + images.length * recordSize;
+    const dataOffsets = [];
+    for (const image of images) {
+      if (image.width <= 0 || image.height <= 0) {
+        throw new Error("Image width or height is zero");
+      }
+      if (image.data.length < image.width * image.height * 4) {
+        throw new Error("Image data length does not match width/height");
+      }
+      dataOffsets.push(byteLength);
+      byteLength += image.width * image.height * 4;
+    }
+
+    const batch = new this._tesseractLib.ByteView(byteLength);
+    try {
+      if (batch.OOM()) {
+        throw new Error("Failed to allocate memory for images");
+      }
+      const bytes = batch.data();
+      const view = new DataView(
+        bytes.buffer,
+        bytes.byteOffset,
+        bytes.byteLength
+      );
+      view.setUint32(0, images.length, true);
+      view.setUint32(4, recordSize, true);
+      view.setUint32(8, headerSize, true);
+      images.forEach((image, i) => {
+        const record = headerSize + i * recordSize;
+        const size = image.width * image.height * 4;
+        view.setUint32(record, dataOffsets[i], true);
+        view.setUint32(record + 4, size, true);
+        view.setInt32(record + 8, image.width, true);
+        view.setInt32(record + 12, image.height, true);
+        view.setInt32(record + 16, 4 /* bytes per pixel */, true);
+        view.setInt32(record + 20, image.width * 4 /* stride */, true);
+        bytes.set(
+          new Uint8Array(image.data.buffer, image.data.byteOffset, size),
+          dataOffsets[i]
+        );
+      });
+
+      const packed = this._engine.recognizeBatch(
+        batch,
+        psm,
+        formatFlags,
+        (progress: number) => {
+          onProgress?.(progress);
+          this._progressChannel?.postMessage({ progress });
+        }
+      );
+      if (!packed) {
+        throw new Error("Invalid batch");
+      }
+      return batchResultsFromPacked(packed, formats);
+    } finally {
+      batch.delete();
+    }
+  }
+
   /**
    * Attempt to determine the orientation of the document image in degrees.
    *
@@ -312,6 +892,26 @@ export class OCREngine {
     return this._engine.getOrientation();
   }
 
+  /**
+   * Return the skew that the "deskew" preprocessing step measured when the
+   * current image was loaded. The angle and confidence are zero if the image
+   * was not deskewed.
+   */
+  getSkew(): Skew {
+    this._checkImageLoaded();
+    return this._engine.getSkew();
+  }
+
+  /**
+   * Return the clockwise rotation, in degrees, that the `autoOrient` option
+   * detected in the current image and corrected. This is 0 if the image was
+   * not rotated.
+   */
+  getAppliedRotation(): number {
+    this._checkImageLoaded();
+    return this._engine.getAppliedRotation();
+  }
+
   private _checkModelLoaded() {
     if (!this._modelLoaded) {
       throw new Error("No text recognition model loaded");
@@ -324,6 +924,49 @@ export class OCREngine {
     }
   }
 
+  private _resultFormatFlags(formats: ResultFormat[]) {
+    let formatFlags = 0;
+    for (const format of formats) {
+      if (!(format in resultFormatFlags)) {
+        throw new Error(`Invalid result format ${format}`);
+      }
+      formatFlags |= resultFormatFlags[format];
+    }
+    return formatFlags;
+  }
+
+  private _loadImageOptions(options: LoadImageOptions) {
+    const { PreprocessOp, UnderlineMode } = this._tesseractLib;
+
+    let underlines;
+    if (options.removeUnderlines === "auto") {
+      underlines = UnderlineMode.Auto;
+    } else if (options.removeUnderlines) {
+      underlines = UnderlineMode.Remove;
+    } else {
+      underlines = UnderlineMode.Keep;
+    }
+
+    const opTypes = {
+      deskew: PreprocessOp.Deskew,
+      "scale-to-dpi": PreprocessOp.ScaleToDPI,
+      denoise: PreprocessOp.Denoise,
+      "normalize-contrast": PreprocessOp.NormalizeContrast,
+      "remove-border": PreprocessOp.RemoveBorder,
+    };
+    const preprocess = new this._tesseractLib["vector<PreprocessStep>"]();
+    for (let step of options.preprocess ?? []) {
+      const op = opTypes[step.op];
+      if (op === undefined) {
+        preprocess.delete();
+        throw new Error(`Invalid preprocessing step "${step.op}"`);
+      }
+      preprocess.push_back({ op, value: step.value ?? 0 });
+    }
+
+    return { underlines, autoOrient: options.autoOrient ?? false, preprocess };
+  }
+
   private _textUnitForUnit(unit: TextUnit) {
     const { TextUnit } = this._tesseractLib;
     switch (unit) {
@@ -354,6 +997,25 @@ function wasmSIMDSupported() {
   return WebAssembly.validate(simdTest);
 }
 
+function wasmRelaxedSIMDSupported() {
+  // Tiny WebAssembly file generated from the following source using `wat2wasm`:
+  //
+  // (module
+  //   (func (result v128)
+  //     i32.const 0
+  //     i8x16.splat
+  //     i32.const 0
+  //     i8x16.splat
+  //     i8x16.relaxed_swizzle
+  //   )
+  // )
+  const relaxedSimdTest = Uint8Array.from([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0, 10, 15, 1,
+    13, 0, 65, 0, 253, 15, 65, 0, 253, 15, 253, 128, 2, 11,
+  ]);
+  return WebAssembly.validate(relaxedSimdTest);
+}
+
 function resolve(path: string, baseURL: string) {
   return new URL(path, baseURL).href;
 }
@@ -367,27 +1029,80 @@ export function supportsFastBuild() {
   return wasmSIMDSupported();
 }
 
+/**
+ * Return true if the current JS runtime supports the relaxed SIMD WebAssembly
+ * instructions used by the "relaxed" build, which is faster than the "fast"
+ * build.
+ */
+export function supportsRelaxedSIMDBuild() {
+  return supportsFastBuild() && wasmRelaxedSIMDSupported();
+}
+
+/**
+ * Return true if the current JS runtime can run the multi-threaded build,
+ * which needs shared memory as well as the features of the "fast" build.
+ */
+export function supportsThreadedBuild() {
+  return supportsFastBuild() && typeof SharedArrayBuffer !== "undefined";
+}
+
 export type CreateOCREngineOptions = {
   /**
    * WebAssembly binary to load. This can be used to customize how the binary URL
-   * is determined and fetched. {@link supportsFastBuild} can be used to
-   * determine which build to load.
+   * is determined and fetched. {@link supportsRelaxedSIMDBuild} and
+   * {@link supportsFastBuild} can be used to determine which build to load.
+   * If `threads` is set, this must be `tesseract-core-mt.wasm`.
    */
   wasmBinary?: Uint8Array | ArrayBuffer;
   progressChannel?: MessagePort;
+
+  /**
+   * Load the multi-threaded build, which recognizes parts of a page
+   * concurrently. Use {@link supportsThreadedBuild} to check whether the
+   * runtime supports it.
+   *
+   * The build's JS runtime, `tesseract-core-mt.js`, is imported from the same
+   * location as this library. The engine blocks while waiting for its
+   * threads, so in browsers it must be used in a Web Worker, eg. via
+   * `OCRClient`, and not on the main thread.
+   */
+  threads?: boolean;
 };
 
+/**
+ * Import the Emscripten runtime of the multi-threaded build.
+ *
+ * This is not bundled with the library, as the runtime's own workers load the
+ * same file.
+ */
+async function importThreadedCore() {
+  const url = resolve("./tesseract-core-mt.js", import.meta.url);
+  const module = await import(/* @vite-ignore */ url);
+  return module.default;
+}
+
 /**
  * Initialize the OCR library and return a new {@link OCREngine}.
  */
 export async function createOCREngine({
   wasmBinary,
   progressChannel,
+  threads = false,
 }: CreateOCREngineOptions = {}) {
+  if (threads && !supportsThreadedBuild()) {
+    throw new Error("The multi-threaded build is not supported");
+  }
   if (!wasmBinary) {
-    const wasmPath = supportsFastBuild()
-      ? "./tesseract-core.wasm"
-      : "./tesseract-core-fallback.wasm";
+    let wasmPath;
+    if (threads) {
+      wasmPath = "./tesseract-core-mt.wasm";
+    } else if (supportsRelaxedSIMDBuild()) {
+      wasmPath = "./tesseract-core-relaxed.wasm";
+    } else if (supportsFastBuild()) {
+      wasmPath = "./tesseract-core.wasm";
+    } else {
+      wasmPath = "./tesseract-core-fallback.wasm";
+    }
 
     // nb. If this code is included in a non-ESM bundle, Rollup will replace
     // `import.meta.url` with code that uses `document.currentScript` /
@@ -396,6 +1111,7 @@ export async function createOCREngine({
     const wasmBinaryResponse = await fetch(wasmURL);
     wasmBinary = await wasmBinaryResponse.arrayBuffer();
   }
-  const tessLib = await initTesseractCore({ wasmBinary });
+  const initCore = threads ? await importThreadedCore() : initTesseractCore;
+  const tessLib = await initCore({ wasmBinary });
   return new OCREngine(tessLib, progressChannel);
 }
@@ -0,0 +1,150 @@
+#ifndef OCRLIB_THREAD_POOL_H
+#define OCRLIB_THREAD_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+// Maximum number of threads in a pool. A pool's threads, one per core up to
+// this limit, must not exceed the number of Web Workers that the Emscripten
+// runtime starts up front (`-sPTHREAD_POOL_SIZE`), as threads created beyond
+// that can't start until the creating thread yields to the event loop. The
+// Makefile sizes both from the core count.
+#ifndef OCRLIB_MAX_THREADS
+#define OCRLIB_MAX_THREADS 32
+#endif
+
+/**
+ * Fixed-size pool of threads for running independent tasks concurrently.
+ *
+ * In builds without pthreads (ie. not compiled with `-pthread`) the pool has
+ * no threads of its own, and `Run` executes tasks on the calling thread.
+ */
+class ThreadPool {
+ public:
+  // Task to run. Receives the index of the task and the index, in
+  // [0, Size()), of the pool thread running it.
+  using Task = std::function<void(size_t task, size_t thread)>;
+
+  // Called on the thread that called `Run` after each task completes, with
+  // the number of completed tasks.
+  using ProgressCallback = std::function<void(size_t completed)>;
+
+  // Return the number of threads that a pool should use by default. This is
+  // 1 if threads are not supported.
+  static size_t DefaultSize() {
+#ifdef __EMSCRIPTEN_PTHREADS__
+    return std::clamp(std::thread::hardware_concurrency(), 1u,
+                      unsigned(OCRLIB_MAX_THREADS));
+#else
+    return 1;
+#endif
+  }
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+  explicit ThreadPool(size_t size) {
+    for (size_t i = 0; i < std::max(size, size_t(1)); i++) {
+      threads_.emplace_back([this, i] { WorkerLoop(i); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  size_t Size() const { return threads_.size(); }
+
+  // Run tasks with indices [0, count) on the pool and wait for them to finish.
+  //
+  // This blocks the calling thread, so it must not be called on the browser
+  // main thread. That would freeze the page, and can deadlock if a pool
+  // thread needs the main thread to act for it. Use the engine in a Web
+  // Worker instead, as `OCRClient` does.
+  //
+  // Calls from several threads run one after another, so a pool can be
+  // shared by engines that are used on different threads.
+  void Run(size_t count, const Task& task,
+           const ProgressCallback& progress = {}) {
+    std::lock_guard<std::mutex> run_lock(run_mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = &task;
+    next_ = 0;
+    count_ = count;
+    completed_ = 0;
+    work_cv_.notify_all();
+
+    size_t reported = 0;
+    while (reported < count) {
+      done_cv_.wait(lock, [&] { return completed_ != reported; });
+      reported = completed_;
+      if (progress) {
+        lock.unlock();
+        progress(reported);
+        lock.lock();
+      }
+    }
+    task_ = nullptr;
+  }
+
+ private:
+  void WorkerLoop(size_t thread) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      work_cv_.wait(lock, [&] { return stop_ || (task_ && next_ < count_); });
+      if (stop_) {
+        return;
+      }
+      auto task = task_;
+      auto index = next_++;
+      lock.unlock();
+      (*task)(index, thread);
+      lock.lock();
+      completed_++;
+      done_cv_.notify_one();
+    }
+  }
+
+  // Held for the duration of `Run`. `mutex_` guards the state of the current
+  // run, and is released while tasks and the progress callback run.
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  const Task* task_ = nullptr;
+  size_t next_ = 0;
+  size_t count_ = 0;
+  size_t completed_ = 0;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+#else
+  explicit ThreadPool(size_t size) {}
+
+  size_t Size() const { return 1; }
+
+  void Run(size_t count, const Task& task,
+           const ProgressCallback& progress = {}) {
+    for (size_t i = 0; i < count; i++) {
+      task(i, 0);
+      if (progress) {
+        progress(i + 1);
+      }
+    }
+  }
+#endif
+};
+
+#endif  // OCRLIB_THREAD_POOL_H
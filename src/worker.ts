@@ -4,6 +4,7 @@ import { createOCREngine } from "./ocr-engine";
 
 type CreateOCREngineOptions = {
   wasmBinary?: Uint8Array | ArrayBuffer;
+  threads?: boolean;
 };
 
 const workerAPI = {
@@ -12,10 +13,14 @@ const workerAPI = {
    *   sent separately from the options argument to enable comlink to transfer it.
    */
   createOCREngine: async (
-    { wasmBinary }: CreateOCREngineOptions,
+    { wasmBinary, threads }: CreateOCREngineOptions,
     progressChannel?: MessagePort
   ) => {
-    const engine = await createOCREngine({ wasmBinary, progressChannel });
+    const engine = await createOCREngine({
+      wasmBinary,
+      progressChannel,
+      threads,
+    });
     return proxy(engine);
   },
 };
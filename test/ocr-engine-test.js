@@ -7,14 +7,20 @@ import {
   createOCREngine,
   layoutFlags,
   supportsFastBuild,
+  supportsRelaxedSIMDBuild,
+  supportsThreadedBuild,
 } from "../dist/lib.js";
 import { loadImage, resolve, toImageData } from "./util.js";
 
 const { StartOfLine, EndOfLine } = layoutFlags;
 
-async function createEngine({ loadModel = true } = {}) {
-  const wasmBinary = await readFile(resolve("../dist/tesseract-core.wasm"));
-  const ocr = await createOCREngine({ wasmBinary });
+async function createEngine({ loadModel = true, threads = false } = {}) {
+  const wasmBinary = await readFile(
+    resolve(
+      threads ? "../dist/tesseract-core-mt.wasm" : "../dist/tesseract-core.wasm"
+    )
+  );
+  const ocr = await createOCREngine({ wasmBinary, threads });
 
   if (loadModel) {
     const model = await readFile(
@@ -49,6 +55,18 @@ describe("supportsFastBuild", () => {
   });
 });
 
+describe("supportsRelaxedSIMDBuild", () => {
+  it("matches the runtime's support for relaxed SIMD", () => {
+    // Relaxed SIMD is enabled by default from Node 22 (V8 11.4+).
+    const nodeMajor = parseInt(process.versions.node.split(".")[0]);
+    if (nodeMajor >= 22) {
+      assert.isTrue(supportsRelaxedSIMDBuild());
+    } else {
+      assert.isBoolean(supportsRelaxedSIMDBuild());
+    }
+  });
+});
+
 describe("OCREngine", () => {
   let ocr;
 
@@ -306,6 +324,152 @@ describe("OCREngine", () => {
     }
   });
 
+  it("extracts several result formats at once", async function () {
+    this.timeout(5_000);
+
+    const imageData = await loadImage(resolve("./small-test-page.jpg"));
+    ocr.loadImage(imageData);
+
+    const results = ocr.getResults(["text", "hocr", "words", "lines"]);
+
+    assert.equal(results.text, ocr.getText());
+    assert.equal(results.hocr, ocr.getHOCR());
+    assert.deepEqual(results.words, ocr.getTextBoxes("word"));
+    assert.deepEqual(results.lines, ocr.getTextBoxes("line"));
+
+    const textOnly = ocr.getResults(["text"]);
+    assert.deepEqual(Object.keys(textOnly), ["text"]);
+    assert.equal(textOnly.text, results.text);
+  });
+
+  it("preprocesses image when loading", async function () {
+    this.timeout(5_000);
+
+    const imageData = await loadImage(resolve("./small-test-page.jpg"));
+    ocr.loadImage(imageData, {
+      preprocess: [{ op: "deskew" }, { op: "denoise" }],
+    });
+
+    const text = ocr.getText();
+    assert.include(text, "This thresholding is a critical step");
+
+    assert.throws(() => {
+      ocr.loadImage(imageData, { preprocess: [{ op: "sharpen" }] });
+    }, 'Invalid preprocessing step "sharpen"');
+  });
+
+  it("recognizes regions of an image", async function () {
+    this.timeout(5_000);
+
+    const imageData = await loadImage(resolve("./small-test-page.jpg"));
+    ocr.loadImage(imageData);
+
+    const lines = ocr.getTextBoxes("line");
+    const text = ocr.getText();
+    const regions = [
+      lines[0].rect,
+      lines[2].rect,
+      { ...lines[1].rect, right: 1e6 },
+    ];
+    const results = ocr.recognizeRegions(regions, ["text", "words"]);
+
+    const firstWord = (text) => text.trim().split(" ")[0];
+    assert.equal(results.length, 3);
+    assert.include(results[0].text, firstWord(lines[0].text));
+    assert.include(results[1].text, firstWord(lines[2].text));
+    assert.equal(results[2].rect.right, imageData.width);
+    for (const [i, region] of results.entries()) {
+      for (const word of region.words) {
+        assert.isAtLeast(word.rect.left, regions[i].left);
+        assert.isAtLeast(word.rect.top, regions[i].top);
+      }
+    }
+
+    // Results for the whole page are kept.
+    assert.equal(ocr.getText(), text);
+    assert.equal(ocr.getResults(["text"]).text, text);
+    assert.deepEqual(ocr.getTextBoxes("line"), lines);
+  });
+
+  it("recognizes pre-segmented lines", async function () {
+    this.timeout(5_000);
+
+    const imageData = await loadImage(resolve("./small-test-page.jpg"));
+    ocr.loadImage(imageData);
+    const expected = ocr.getTextBoxes("line");
+
+    ocr.loadImage(imageData);
+    const lines = ocr.recognizeLines([
+      ...expected.map((line) => line.rect),
+      { left: 0, top: 0, right: 0, bottom: 0 },
+    ]);
+
+    assert.equal(lines.length, expected.length + 1);
+    for (const [i, line] of expected.entries()) {
+      assert.deepEqual(lines[i].rect, line.rect);
+      assert.equal(lines[i].flags, StartOfLine | EndOfLine);
+      assert.include(lines[i].text, line.text.trim().split(" ")[0]);
+      assert.isAbove(lines[i].confidence, 0.5);
+    }
+    assert.equal(lines.at(-1).text, "");
+  });
+
+  it("keeps page results when recognizing lines", async function () {
+    this.timeout(5_000);
+
+    const imageData = await loadImage(resolve("./small-test-page.jpg"));
+    ocr.loadImage(imageData);
+    const text = ocr.getText();
+    const words = ocr.getTextBoxes("word");
+
+    ocr.recognizeLines(words.slice(0, 3).map((word) => word.rect));
+
+    assert.equal(ocr.getText(), text);
+    assert.deepEqual(ocr.getTextBoxes("word"), words);
+  });
+
+  it("recognizes a batch of images", async function () {
+    this.timeout(5_000);
+
+    const imagePath = resolve("./small-test-page.jpg");
+    ocr.loadImage(await loadImage(imagePath));
+    const text = ocr.getText();
+    const lines = ocr.getTextBoxes("line").slice(0, 3);
+
+    const images = [];
+    for (const { rect } of lines) {
+      const image = sharp(imagePath)
+        .ensureAlpha()
+        .extract({
+          left: rect.left,
+          top: rect.top,
+          width: rect.right - rect.left,
+          height: rect.bottom - rect.top,
+        });
+      images.push(await toImageData(image));
+    }
+    const results = ocr.recognizeBatch(images, ["text", "words"], {
+      layout: "line",
+    });
+
+    assert.equal(results.length, lines.length);
+    for (const [i, result] of results.entries()) {
+      assert.isUndefined(result.error);
+      assert.include(result.text, lines[i].text.trim().split(" ")[0]);
+      assert.isAbove(result.words.length, 0);
+
+      // Boxes are relative to the image.
+      for (const { rect } of result.words) {
+        assert.isAtLeast(rect.left, 0);
+        assert.isAtMost(rect.right, images[i].width);
+        assert.isAtMost(rect.bottom, images[i].height);
+      }
+    }
+
+    // The page image and its results are kept.
+    assert.equal(ocr.getText(), text);
+  });
+
   it("reports recognition progress", async function () {
     this.timeout(5_000);
 
@@ -351,6 +515,76 @@ describe("OCREngine", () => {
     }
   });
 
+  it("rotates images upright when loading", async () => {
+    const imagePath = resolve("./small-test-page.jpg");
+
+    for (let rotation of [0, 90, 180, 270]) {
+      const image = await sharp(imagePath).ensureAlpha().rotate(rotation);
+
+      ocr.loadImage(await toImageData(image), { autoOrient: true });
+
+      assert.equal(ocr.getAppliedRotation(), rotation);
+      assert.equal(ocr.getOrientation().rotation, 0);
+    }
+  });
+
+  it("reports the skew of deskewed images", async function () {
+    this.timeout(5_000);
+
+    const image = sharp(resolve("./small-test-page.jpg"))
+      .ensureAlpha()
+      .rotate(2, { background: "white" });
+    const imageData = await toImageData(image);
+    ocr.loadImage(imageData, {
+      preprocess: [{ op: "deskew", value: 4 }],
+    });
+
+    const skew = ocr.getSkew();
+    assert.approximately(Math.abs(skew.angle), 2, 0.2);
+    assert.isAtLeast(skew.confidence, 3);
+
+    ocr.loadImage(imageData);
+    assert.deepEqual(ocr.getSkew(), { angle: 0, confidence: 0 });
+  });
+
+  it("scales images down to fit the memory budget", async () => {
+    const imageData = await loadImage(resolve("./small-test-page.jpg"));
+    ocr.loadImage(imageData);
+    assert.equal(ocr.getImageScale(), 1);
+
+    // Allow about a quarter of the memory that the image needs.
+    const pixels = imageData.width * imageData.height;
+    ocr.setMemoryBudget(pixels * 6.5 * 0.25);
+    ocr.loadImage(imageData);
+    assert.approximately(ocr.getImageScale(), 0.5, 0.01);
+
+    const words = ocr.getTextBoxes("word");
+    const maxRight = Math.max(...words.map((w) => w.rect.right));
+    assert.isAtMost(maxRight, imageData.width / 2 + 1);
+
+    ocr.setMemoryBudget(0);
+  });
+
+  it("recognizes large images in tiles", async function () {
+    this.timeout(10_000);
+
+    const imageData = await loadImage(resolve("./small-test-page.jpg"));
+    ocr.setTileSize(600, 150);
+    ocr.loadImage(imageData);
+
+    const text = ocr.getText();
+    assert.include(text, "This thresholding is a critical step");
+
+    // Words in the overlap between tiles are only reported once.
+    const words = ocr.getTextBoxes("word");
+    const keys = words.map(
+      ({ rect }) => `${rect.left},${rect.top},${rect.right},${rect.bottom}`
+    );
+    assert.equal(new Set(keys).size, keys.length);
+
+    ocr.setTileSize(0);
+  });
+
   it("clears the image", async () => {
     ocr.loadImage(emptyImage(100, 100));
     ocr.getBoundingBoxes("word");
@@ -362,3 +596,35 @@ describe("OCREngine", () => {
     }, "No image loaded");
   });
 });
+
+describe("OCREngine (multi-threaded build)", () => {
+  let ocr;
+  let serialOCR;
+
+  before(async function () {
+    assert.isTrue(supportsThreadedBuild());
+    ocr = await createEngine({ threads: true });
+    serialOCR = await createEngine();
+  });
+
+  after(() => {
+    ocr?.destroy();
+    serialOCR?.destroy();
+  });
+
+  it("recognizes the same text as the single-threaded build", async function () {
+    this.timeout(10_000);
+
+    const imageData = await loadImage(resolve("./test-page.jpg"));
+    ocr.loadImage(imageData);
+    serialOCR.loadImage(imageData);
+
+    const results = ocr.getResults(["text", "words"]);
+    const expected = serialOCR.getResults(["text", "words"]);
+    assert.equal(results.text, expected.text);
+    assert.deepEqual(
+      results.words.map((word) => word.rect),
+      expected.words.map((word) => word.rect)
+    );
+  });
+});
@@ -0,0 +1,76 @@
+// Checks that binarizing in tiles with `map_tiles` matches Leptonica's
+// `pixSauvolaBinarizeTiled`. Build and run with `make test-native`.
+//
+// lib.cpp is included directly so that the test can call its internal
+// functions.
+#define OCRLIB_NO_EMBIND
+#include "../src/lib.cpp"
+
+#include <cstdio>
+
+namespace {
+
+// Create an 8bpp image with a background gradient and dark strokes, so that
+// the threshold varies across the image and between tiles.
+PIX* create_test_image(int width, int height) {
+  PIX* pix = pixCreate(width, height, 8);
+  uint32_t seed = 1;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245 + 12345;
+      int value = 140 + (x + y) * 100 / (width + height) + (seed >> 16) % 16;
+      if ((y % 24) < 3 && (x / 7) % 3 != 0) {
+        value -= 100;
+      }
+      pixSetPixel(pix, x, y, std::clamp(value, 0, 255));
+    }
+  }
+  return pix;
+}
+
+bool check_matches_tiled(ThreadPool& pool, int width, int height) {
+  PIX* pixs = create_test_image(width, height);
+
+  PIX* pixd = sauvola_binarize_tiles(pool, pixs);
+
+  // Use as many tiles as `sauvola_binarize_tiles`. The tiles are placed
+  // differently, but the result should not depend on the tiling.
+  const int tile_size = 512;
+  int nx = std::max(1, width / tile_size);
+  int ny = std::max(1, height / tile_size);
+  PIX* pix_expected = nullptr;
+  pixSauvolaBinarizeTiled(pixs, 8, 0.34, nx, ny, NULL, &pix_expected);
+
+  l_int32 same = 0;
+  if (pixd && pix_expected) {
+    pixEqual(pixd, pix_expected, &same);
+  }
+  if (!same) {
+    std::fprintf(stderr, "Tiled binarization of %dx%d image does not match\n",
+                 width, height);
+  }
+
+  pixDestroy(&pixs);
+  pixDestroy(&pixd);
+  pixDestroy(&pix_expected);
+  return same;
+}
+
+}  // namespace
+
+int main() {
+  ThreadPool pool(4);
+  bool ok = true;
+
+  // Images larger than a tile in one or both dimensions, including sizes that
+  // are not a multiple of the tile size.
+  ok &= check_matches_tiled(pool, 1100, 700);
+  ok &= check_matches_tiled(pool, 1024, 1024);
+  ok &= check_matches_tiled(pool, 300, 1500);
+
+  if (!ok) {
+    return 1;
+  }
+  std::printf("OK\n");
+  return 0;
+}